@@ -0,0 +1,305 @@
+/* benchmark - Times the core operations of joblog on generated logs
+ *
+ * Generates logs of the given size in a temporary directory and times
+ * loading, checking, listing and saving them, and the date conversions.
+ * Each result is printed as one JSON object per line, so that the output
+ * of two versions can be compared by a script.
+ */
+
+#define JOBLOG_NO_MAIN
+#include "../joblog.cpp"
+
+#include <random>    // generated logs
+#include <chrono>    // timing
+
+const string BENCH_HELPMSG(
+  "Useage: benchmark [<args>]\n"
+  "       benchmark generate <dir> [<args>]\n"
+  "\n"
+  "Time the core operations on generated logs and print the results as JSON\n"
+  "lines. With 'generate', only write the logs to the given directory,\n"
+  "which must not exist yet.\n"
+  "\n"
+  "Arguments:\n"
+  " -years=<n>     Years of logs to generate (default 5).\n"
+  " -sessions=<n>  Sessions per working day (default 4).\n"
+  " -notes=<n>     Average length of a note in bytes (default 40).\n"
+  " -runs=<n>      Runs per benchmark, the median is reported (default 5).\n"
+  " -binary        Store the logs in the binary format."
+);
+
+struct BenchConfig {
+    int years = 5;
+    int sessions = 4;
+    int noteLength = 40;
+    int runs = 5;
+    LogFormat format = LogFormat::text;
+};
+
+const char *BENCH_WORDS[] = {
+    "fixed", "the", "parser", "review", "meeting", "with", "team", "about",
+    "release", "wrote", "tests", "for", "index", "segments", "cleanup",
+    "docs", "build", "profile", "memory", "daemon", "import", "report"
+};
+
+/* A note of about the given length from common words. */
+string makeNote(std::mt19937& random, int length) {
+    std::uniform_int_distribution<int> lengths(length / 2, length * 3 / 2);
+    std::uniform_int_distribution<size_t> words(0,
+            sizeof(BENCH_WORDS) / sizeof(BENCH_WORDS[0]) - 1);
+    size_t target = std::max(lengths(random), 1);
+    string res;
+    while (res.size() < target) {
+        if (! res.empty())
+            res += ' ';
+        res += BENCH_WORDS[words(random)];
+    }
+    return res;
+}
+
+/* Write logs that end before now to the given directory. Work happens on
+ * week days, in sessions between 8:00 and 20:00 with a few logs each. */
+size_t generateLogs(const string& path, const BenchConfig& config) {
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int> logCount(0, 4);
+    std::uniform_int_distribution<int> jitter(0, 600);
+    dt::time_point today = dt::getBeginOfDay(dt::now());
+    long long last = dt::toDayNumber(today);
+    long long first = last - config.years * 365;
+    // The sessions of a day share the 12 hours between 8:00 and 20:00.
+    int slot = 12 * 3600 / std::max(config.sessions, 1);
+    string out;
+    size_t count = 0;
+    for (long long day=first; day<last; day++) {
+        // 01.01.1970 was a Thursday
+        if ((day + 3) % 7 >= 5)
+            continue;
+        dt::time_point begin = dt::beginOfDayNumber(day) + dt::hours(8);
+        for (int s=0; s<config.sessions; s++) {
+            dt::time_point time = begin + dt::seconds(s * slot +
+                                                      jitter(random));
+            dt::time_point end = time + dt::seconds(slot * 3 / 4);
+            LogEntry(LogEntryType::start, time, "").appendLine(out);
+            int logs = logCount(random);
+            for (int l=0; l<logs; l++) {
+                time += dt::seconds(slot / 2 / (logs + 1));
+                string note = makeNote(random, config.noteLength);
+                LogEntry(LogEntryType::log, time, note).appendLine(out);
+            }
+            LogEntry(LogEntryType::end, end, "").appendLine(out);
+            count += logs + 2;
+        }
+    }
+    if (mkdir(path.c_str(), 0755) != 0)
+        throw CorruptedFileException("Could not create "+path);
+    LogList::create(path, LogFormat::text);
+    writeSegments(path, out.data(), out.size());
+    if (config.format == LogFormat::binary) {
+        LogList loglist(path, false);
+        loglist.convert(LogFormat::binary);
+    }
+    return count;
+}
+
+/* Runs benchmarks and prints their results. */
+class Bench {
+private:
+    BenchConfig config;
+    string format;
+    size_t entries;
+public:
+    Bench(const BenchConfig& config, size_t entries) {
+        this->config = config;
+        this->format = config.format == LogFormat::binary ? "binary" : "text";
+        this->entries = entries;
+    }
+
+    /* Time the given function. 'ops' is the number of items it handles,
+     * to report the time per item. The setup is not timed. */
+    void run(const string& name, size_t ops,
+             const std::function<void()>& measured,
+             const std::function<void()>& setup = nullptr) {
+        vector<double> samples;
+        for (int i=0; i<this->config.runs; i++) {
+            if (setup)
+                setup();
+            auto begin = std::chrono::steady_clock::now();
+            measured();
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(
+                    std::chrono::duration<double, std::milli>(end - begin)
+                    .count());
+        }
+        std::sort(samples.begin(), samples.end());
+        double median = samples[samples.size() / 2];
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "{\"benchmark\":\"%s\",\"format\":\"%s\",\"entries\":%zu,"
+                 "\"runs\":%d,\"min_ms\":%.3f,\"median_ms\":%.3f,"
+                 "\"ops\":%zu,\"ns_per_op\":%.1f}",
+                 name.c_str(), this->format.c_str(), this->entries,
+                 this->config.runs, samples.front(), median, ops,
+                 ops > 0 ? median * 1e6 / ops : 0.0);
+        std::cout << line << std::endl;
+    }
+};
+
+void runBenchmarks(const string& path, const BenchConfig& config,
+                   size_t count) {
+    Bench bench(config, count);
+
+    bench.run("construct_recent", 1, [&]() {
+        delete new LogList(path, true);
+    });
+    bench.run("construct_all", count, [&]() {
+        delete new LogList(path, false);
+    });
+    {
+        LogList loglist(path, false);
+        // Without the checkpoint, all entries are checked again.
+        bench.run("check_full", count, [&]() {
+            loglist.check();
+        }, [&]() {
+            unlink((path + "/checked").c_str());
+        });
+        // The last run left the checkpoint, so only the bytes it covers
+        // are hashed.
+        bench.run("check_incremental", count, [&]() {
+            loglist.check();
+        });
+    }
+
+    dt::time_point now = dt::now();
+    struct Range {
+        const char *name;
+        dt::time_point from;
+    };
+    Range ranges[] = {
+        {"list_day", dt::getBeginOfDay(now)},
+        {"list_week", dt::getLastMonday(now)},
+        {"list_month", dt::getLastFirstOfMonth(now)},
+        {"list_year", dt::getLastFirstOfYear(now)},
+        {"list_all", dt::clock::from_time_t(0)},
+    };
+    for (bool recent : {true, false}) {
+        LogList loglist(path, recent);
+        for (Range& range : ranges) {
+            dt::time_point from = range.from;
+            dt::time_point to = now;
+            bool includeLogs = true;
+            size_t listed = loglist.list(from, to, includeLogs).size();
+            bench.run(string(range.name) + (recent ? "_recent" : "_loaded"),
+                      listed, [&]() {
+                dt::time_point from = range.from;
+                dt::time_point to = now;
+                bool includeLogs = true;
+                loglist.list(from, to, includeLogs);
+            });
+        }
+    }
+
+    {
+        // Each run appends a session, the rewrite moves its end.
+        LogList loglist(path, true);
+        bench.run("save_append", 3, [&]() {
+            loglist.save();
+        }, [&]() {
+            loglist.start(false);
+            loglist.log("benchmark");
+            loglist.end(false);
+        });
+        bench.run("save_rewrite", 1, [&]() {
+            loglist.save();
+        }, [&]() {
+            loglist.end(true);
+        });
+    }
+
+    const size_t DATES = 1000000;
+    std::mt19937 random(2);
+    std::uniform_int_distribution<long long> seconds(0, 10LL * 365 * 86400);
+    vector<dt::time_point> times(DATES);
+    vector<string> strings(DATES);
+    for (size_t i=0; i<DATES; i++) {
+        times[i] = now - dt::seconds(seconds(random));
+        strings[i] = dt::toString(times[i]);
+    }
+    volatile long long sink = 0;
+    bench.run("parse_date", DATES, [&]() {
+        for (const string& str : strings)
+            sink += dt::parseDateStr(str).time_since_epoch().count();
+    });
+    bench.run("format_date", DATES, [&]() {
+        for (const dt::time_point& time : times)
+            sink += dt::toString(time).size();
+    });
+    // Entries of the logs come in order and mostly share their day.
+    std::sort(times.begin(), times.end());
+    bench.run("format_date_sorted", DATES, [&]() {
+        for (const dt::time_point& time : times)
+            sink += dt::toString(time).size();
+    });
+}
+
+/* Read an argument of the form -<name>=<number>. */
+bool numberArg(const string& arg, const string& name, int& out) {
+    string prefix = "-" + name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+    out = std::max(atoi(arg.c_str() + prefix.size()), 1);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    vector<string> args(argv + 1, argv + argc);
+    string target;
+    if (! args.empty() && args[0].compare("generate") == 0) {
+        if (args.size() < 2) {
+            std::cout << BENCH_HELPMSG << std::endl;
+            return 2;
+        }
+        target = args[1];
+        args.erase(args.begin(), args.begin() + 2);
+    }
+    BenchConfig config;
+    for (const string& arg : args) {
+        if (arg.compare("--help") == 0) {
+            std::cout << BENCH_HELPMSG << std::endl;
+            return 0;
+        }
+        else if (arg.compare("-binary") == 0) {
+            config.format = LogFormat::binary;
+        }
+        else if (! numberArg(arg, "years", config.years) &&
+                 ! numberArg(arg, "sessions", config.sessions) &&
+                 ! numberArg(arg, "notes", config.noteLength) &&
+                 ! numberArg(arg, "runs", config.runs)) {
+            std::cout << "Unknown argument '" << arg << "'" << std::endl;
+            std::cout << "Use --help to see valid arguments." << std::endl;
+            return 2;
+        }
+    }
+
+    try {
+        if (! target.empty()) {
+            size_t count = generateLogs(target, config);
+            std::cout << "Generated " << count << " entries." << std::endl;
+            return 0;
+        }
+        char tmp[] = "/tmp/joblog-bench-XXXXXX";
+        if (mkdtemp(tmp) == nullptr) {
+            std::cout << "Could not create a temporary directory."
+                      << std::endl;
+            return 2;
+        }
+        string path = string(tmp) + "/" + SAVEPATH;
+        size_t count = generateLogs(path, config);
+        runBenchmarks(path, config, count);
+        std::system(("rm -rf '" + string(tmp) + "'").c_str());
+    } catch (CustomException& ex) {
+        std::cout << "The benchmark failed. The exception message is:\n'"
+                  << ex.what() << "'" << std::endl;
+        return 2;
+    }
+    return 0;
+}
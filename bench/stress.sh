@@ -0,0 +1,54 @@
+#!/bin/sh
+# Stress benchmark for concurrent appends.
+#
+# Usage: bench/stress.sh <joblog binary> [writers] [logs per writer]
+#
+# Starts a session in a fresh directory, lets the given number of processes
+# write logs at the same time and reports the appends per second. Afterwards
+# the logs are checked: every log has to be there and the file has to pass
+# 'joblog -c'.
+
+JOBLOG=${1:?"usage: $0 <joblog binary> [writers] [logs per writer]"}
+WRITERS=${2:-8}
+LOGS=${3:-200}
+
+case "$JOBLOG" in
+    /*) ;;
+    *) JOBLOG="$(pwd)/$JOBLOG" ;;
+esac
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+cd "$DIR" || exit 1
+"$JOBLOG" init > /dev/null || exit 1
+"$JOBLOG" start > /dev/null || exit 1
+
+BEGIN=$(date +%s.%N)
+w=0
+while [ $w -lt "$WRITERS" ]; do
+    (
+        i=0
+        while [ $i -lt "$LOGS" ]; do
+            "$JOBLOG" log "writer $w log $i" > /dev/null || echo "failed"
+            i=$((i + 1))
+        done
+    ) &
+    w=$((w + 1))
+done
+wait
+END=$(date +%s.%N)
+
+"$JOBLOG" end > /dev/null || exit 1
+
+TOTAL=$((WRITERS * LOGS))
+FOUND=$(cd .joblog && cat $(cut -d" " -f1 manifest) | grep -c " log writer ")
+echo "writers:      $WRITERS"
+echo "appends:      $TOTAL"
+echo "$BEGIN $END $TOTAL" | awk '{ printf "seconds:      %.3f\n", $2 - $1;
+    printf "appends/s:    %.0f\n", $3 / ($2 - $1) }'
+if [ "$FOUND" -ne "$TOTAL" ] || ! "$JOBLOG" -c state > /dev/null; then
+    echo "FAILED: found $FOUND of $TOTAL logs"
+    "$JOBLOG" -c state
+    exit 1
+fi
+echo "all logs found, the file is consistent"
@@ -0,0 +1,186 @@
+/* Methods for the binary format
+ *
+ * The binary format consists of two files. 'logs.bin' starts with a header
+ * and holds a record of fixed size for each entry. 'logs.notes' holds the
+ * notes back to back, the records refer to them by offset and length.
+ * Numbers are stored in the byte order of the machine.
+ */
+
+const char BINARYMAGIC[8] = {'J','O','B','L','O','G','B','N'};
+const uint32_t BINARYVERSION = 1;
+
+struct BinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint8_t reserved[16];
+};
+
+struct BinaryRecord {
+    // seconds since 01.01.1970
+    int64_t time;
+    uint64_t noteOffset;
+    uint32_t noteLength;
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(BinaryHeader) == 32, "Unexpected binary header size");
+static_assert(sizeof(BinaryRecord) == 24, "Unexpected binary record size");
+
+string binaryHeader() {
+    BinaryHeader header{};
+    memcpy(header.magic, BINARYMAGIC, 8);
+    header.version = BINARYVERSION;
+    header.recordSize = sizeof(BinaryRecord);
+    return string((const char *) &header, sizeof(header));
+}
+
+BinaryRecord binaryRecord(LogEntryType type, const dt::time_point& time,
+                          size_t noteOffset, size_t noteLength) {
+    BinaryRecord record{};
+    record.time = dt::to_time_t(time);
+    record.noteOffset = noteOffset;
+    record.noteLength = noteLength;
+    record.type = (uint8_t) type;
+    return record;
+}
+
+/* Create empty logs in the given directory. */
+void LogList::create(const string& path, LogFormat format) {
+    if (format == LogFormat::binary) {
+        writeFile(path + "/logs.notes", "");
+        writeFile(path + "/logs.bin", binaryHeader());
+    }
+    else {
+        writeManifest(path, vector<Segment>());
+    }
+    Rollups rollups;
+    rollups.setFile(path + "/rollups");
+    rollups.write();
+    Postings postings;
+    SearchIndex::write(path + "/search", postings, INT64_MIN);
+}
+
+/* Map both files of the binary format and take over the records. */
+void LogList::loadBinary() {
+    this->mapping.map(this->fd);
+    this->notesMapping.map(this->notesFd);
+    size_t notesSize = this->notesMapping.getSize();
+    // The note heap is the first block, so offsets in the pool are offsets
+    // in the heap.
+    this->notes.addExternal(this->notesMapping.getData(), notesSize);
+    this->savedNotes = notesSize;
+    
+    const char *data = this->mapping.getData();
+    size_t size = this->mapping.getSize();
+    const BinaryHeader *header = (const BinaryHeader *) data;
+    if (size < sizeof(BinaryHeader) ||
+                memcmp(header->magic, BINARYMAGIC, 8) != 0 ||
+                header->version != BINARYVERSION ||
+                header->recordSize != sizeof(BinaryRecord)) {
+        throw CorruptedFileException("Unknown format of logs.bin");
+    }
+    ProfileScope scope(Phase::parse);
+    // A record that was not written completely is ignored.
+    size_t count = (size - sizeof(BinaryHeader)) / sizeof(BinaryRecord);
+    Profiler::linesParsed += count;
+    Profiler::bytesRead += count * sizeof(BinaryRecord);
+    const BinaryRecord *records =
+            (const BinaryRecord *) (data + sizeof(BinaryHeader));
+    this->entries.reserve(count);
+    for (size_t i=0; i<count; i++) {
+        const BinaryRecord& record = records[i];
+        if (record.type > (uint8_t) LogEntryType::log ||
+                    record.noteOffset + record.noteLength > notesSize) {
+            throw CorruptedFileException(
+                    "Broken record "+std::to_string(i)+" in logs.bin");
+        }
+        this->entries.push((LogEntryType) record.type,
+                           dt::clock::from_time_t(record.time),
+                           record.noteOffset, record.noteLength);
+    }
+}
+
+/* Write the changes to the files of the binary format. */
+void LogList::saveBinary() {
+    // Notes go first, as the records refer to them. New notes were added to
+    // the pool back to back behind the heap, so their offsets are already
+    // those in the heap.
+    if (this->notes.size() > this->savedNotes) {
+        writeAll(this->notesFd, this->notes.copySince(this->savedNotes),
+                 this->savedNotes);
+        this->savedNotes = this->notes.size();
+    }
+    // Only the last record can have been changed.
+    size_t first = std::min(this->amended,
+                            this->entries.size() - this->needsToBeWritten);
+    if (first >= this->entries.size())
+        return;
+    vector<BinaryRecord> records;
+    records.reserve(this->entries.size() - first);
+    for (size_t i=first; i<this->entries.size(); i++) {
+        records.push_back(binaryRecord(this->entries.types[i],
+                this->entries.times[i], this->entries.noteOffsets[i],
+                this->entries.noteLengths[i]));
+    }
+    string out((const char *) records.data(),
+               records.size() * sizeof(BinaryRecord));
+    size_t offset = sizeof(BinaryHeader) + first * sizeof(BinaryRecord);
+    if (this->amended < this->entries.size()) {
+        overwriteTail(this->path, "logs.bin", this->fd, out, offset);
+        return;
+    }
+    writeAll(this->fd, out, offset);
+    if (ftruncate(this->fd, offset + out.size()) != 0) {
+        throw CorruptedFileException("Could not write the log file");
+    }
+}
+
+/* Store all entries in the given format instead and remove the files of the
+ * old one. The new files are written completely before they replace the old
+ * ones, so the logs are never lost in between. */
+void LogList::convert(LogFormat to) {
+    if (to == this->format) {
+        throw SituationalMistake("The logs are already in this format");
+    }
+    this->loadAll();
+    if (to == LogFormat::binary) {
+        string heap;
+        vector<BinaryRecord> records;
+        records.reserve(this->entries.size());
+        for (size_t i=0; i<this->entries.size(); i++) {
+            std::string_view note = this->getEntry(i).viewNote();
+            records.push_back(binaryRecord(this->entries.types[i],
+                    this->entries.times[i], heap.size(), note.size()));
+            heap.append(note);
+        }
+        string out = binaryHeader();
+        out.append((const char *) records.data(),
+                   records.size() * sizeof(BinaryRecord));
+        writeFile(this->path + "/logs.notes.tmp", heap);
+        writeFile(this->path + "/logs.bin.tmp", out);
+        // Once 'logs.bin' exists, it is used.
+        if (rename((this->path + "/logs.notes.tmp").c_str(),
+                   (this->path + "/logs.notes").c_str()) != 0 ||
+            rename((this->path + "/logs.bin.tmp").c_str(),
+                   (this->path + "/logs.bin").c_str()) != 0) {
+            throw CorruptedFileException("Could not replace the logs");
+        }
+        removeSegments(this->path);
+    }
+    else {
+        string out;
+        for (size_t i=0; i<this->entries.size(); i++) {
+            this->getEntry(i).appendLine(out);
+        }
+        writeSegments(this->path, out.data(), out.size());
+        // Once 'logs.bin' is gone, the segments are used.
+        unlink((this->path + "/logs.bin").c_str());
+        unlink((this->path + "/logs.notes").c_str());
+    }
+    // The old files are gone, there is nothing to save to them.
+    this->needsToBeWritten = 0;
+    this->amended = SIZE_MAX;
+    this->savedNotes = this->notes.size();
+}
@@ -0,0 +1,172 @@
+/* Check methods
+ *
+ * The file 'checked' holds a checkpoint: how far the logs were checked, a
+ * checksum of that part and the state at its end. A check only needs to
+ * read the entries behind it, as long as the checksum still matches.
+ */
+
+// The file starts with this, followed by the offset, the checksum, the
+// time of the last entry, whether a session was running and the name of
+// the file the offset is in.
+const char CHECKMAGIC[8] = {'J','L','C','H','C','K','0','1'};
+const size_t CHECKHEADERSIZE = 40;
+const uint64_t CHECKSEED = 14695981039346656037ULL;
+
+/* Check that the sessions are paired and the entries are sorted, beginning
+ * at the given position with the state before it. The state is updated to
+ * the end of the entries. */
+void LogList::checkEntries(EntryColumns& columns, size_t first, bool& active,
+                           dt::time_point& last) {
+    const vector<LogEntryType>& types = columns.types;
+    const vector<dt::time_point>& times = columns.times;
+    for (size_t i=first; i<types.size(); i++) {
+        if (types[i] == LogEntryType::start) {
+            if (active)
+                throw CorruptedFileException("Two starts without end");
+            active = true;
+        }
+        else if (types[i] == LogEntryType::end) {
+            if (! active)
+                throw CorruptedFileException("Two ends without start");
+            active = false;
+        }
+        if (times[i] < last)
+            throw CorruptedFileException("Entries not sorted");
+        last = times[i];
+    }
+}
+
+/* Read the checkpoint. Returns false if there is none or it is broken. */
+bool LogList::readCheckpoint(Checkpoint& point) {
+    std::ifstream file(this->path + "/checked", std::ios::binary);
+    char header[CHECKHEADERSIZE];
+    if (! file.read(header, CHECKHEADERSIZE) ||
+                memcmp(header, CHECKMAGIC, 8) != 0)
+        return false;
+    uint64_t active;
+    memcpy(&point.offset, header + 8, 8);
+    memcpy(&point.checksum, header + 16, 8);
+    memcpy(&point.last, header + 24, 8);
+    memcpy(&active, header + 32, 8);
+    point.active = active != 0;
+    point.file.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+    return true;
+}
+
+/* Store the checkpoint. Other readers might check at the same time, so the
+ * file is replaced as a whole. A checkpoint that can not be written only
+ * costs a full check next time. */
+void LogList::writeCheckpoint(const Checkpoint& point) {
+    uint64_t active = point.active ? 1 : 0;
+    string out(CHECKMAGIC, 8);
+    out.append((const char *) &point.offset, 8);
+    out.append((const char *) &point.checksum, 8);
+    out.append((const char *) &point.last, 8);
+    out.append((const char *) &active, 8);
+    out += point.file;
+    string filename = this->path + "/checked";
+    string temporary = filename + ".tmp" + std::to_string(getpid());
+    try {
+        writeFile(temporary, out);
+    } catch (CorruptedFileException& ex) {
+        unlink(temporary.c_str());
+        return;
+    }
+    if (rename(temporary.c_str(), filename.c_str()) != 0)
+        unlink(temporary.c_str());
+}
+
+/* Continue the hash over the whole segments between the given ones. */
+uint64_t LogList::hashSegments(size_t from, size_t to, uint64_t hash) {
+    for (size_t i=from; i<to; i++) {
+        MappedFile *mapping = this->mapSegment(i);
+        hash = fastChecksum(mapping->getData(), mapping->getSize(), hash);
+    }
+    return hash;
+}
+
+/* Check the entries behind the checkpoint and move it to the end of the
+ * logs. Returns false if the checked part was changed, the logs have to be
+ * checked as a whole then. The files before the checkpoint are only
+ * hashed, not parsed. */
+bool LogList::checkSince(Checkpoint& point) {
+    dt::time_point last = dt::time_point(dt::duration(point.last));
+    if (this->format == LogFormat::binary) {
+        const char *data = this->mapping.getData();
+        size_t size = sizeof(BinaryHeader) +
+                      this->entries.size() * sizeof(BinaryRecord);
+        if (point.file != "logs.bin" || point.offset < sizeof(BinaryHeader) ||
+                    point.offset > size || (point.offset -
+                    sizeof(BinaryHeader)) % sizeof(BinaryRecord) != 0 ||
+                    fastChecksum(data, point.offset, CHECKSEED) !=
+                    point.checksum)
+            return false;
+        size_t first = (point.offset - sizeof(BinaryHeader)) /
+                       sizeof(BinaryRecord);
+        LogList::checkEntries(this->entries, first, point.active, last);
+        point.offset = size;
+        point.checksum = fastChecksum(data, size, CHECKSEED);
+        point.last = last.time_since_epoch().count();
+        return true;
+    }
+
+    if (this->segments.empty())
+        return point.file.empty() && point.offset == 0;
+    size_t newest = this->segments.size() - 1;
+    size_t checked = 0;
+    while (checked <= newest && this->segments[checked].name != point.file)
+        checked++;
+    if (checked > newest)
+        return false;
+    MappedFile *mapping = this->mapSegment(checked);
+    const char *data = mapping->getData();
+    if (point.offset > mapping->getSize() ||
+                (point.offset > 0 && data[point.offset - 1] != '\n'))
+        return false;
+    uint64_t before = this->hashSegments(0, checked, CHECKSEED);
+    if (fastChecksum(data, point.offset, before) != point.checksum)
+        return false;
+
+    vector<ParseTask> ranges(newest - checked + 1);
+    for (size_t i=checked; i<=newest; i++) {
+        ParseTask& range = ranges[i - checked];
+        range.segment = i;
+        range.from = i == checked ? point.offset : 0;
+        range.to = this->mapSegment(i)->getSize();
+    }
+    EntryColumns added;
+    this->parseRanges(ranges, added);
+    LogList::checkEntries(added, 0, point.active, last);
+    point.file = this->segments[newest].name;
+    point.offset = this->mapSegment(newest)->getSize();
+    point.checksum = this->hashSegments(checked, newest + 1, before);
+    point.last = last.time_since_epoch().count();
+    return true;
+}
+
+/* A checkpoint at the end of the logs, after all of them were checked. */
+Checkpoint LogList::checkpointAtEnd(bool active,
+                                    const dt::time_point& last) {
+    Checkpoint point;
+    point.active = active;
+    point.last = last.time_since_epoch().count();
+    if (this->format == LogFormat::binary) {
+        point.file = "logs.bin";
+        point.offset = sizeof(BinaryHeader) +
+                       this->entries.size() * sizeof(BinaryRecord);
+        point.checksum = fastChecksum(this->mapping.getData(), point.offset,
+                                      CHECKSEED);
+    }
+    else if (this->segments.empty()) {
+        point.offset = 0;
+        point.checksum = CHECKSEED;
+    }
+    else {
+        size_t newest = this->segments.size() - 1;
+        point.file = this->segments[newest].name;
+        point.offset = this->mapSegment(newest)->getSize();
+        point.checksum = this->hashSegments(0, newest + 1, CHECKSEED);
+    }
+    return point;
+}
@@ -1,130 +1,586 @@
 /* Core methods
  */
 
-/* Create a LogEntry for a recent event. */
-LogEntry::LogEntry() {
-    this->time = dt::now();
-}
-
-/* Create a LogEntry for a specified time. */
-LogEntry::LogEntry(const dt::time_point& time) {
+LogEntry::LogEntry(LogEntryType kind, const dt::time_point& time,
+                   std::string_view note) {
+    this->kind = kind;
     this->time = time;
+    this->note = note;
 }
 
 /* Create a string representation to be saved in a file. */
 string LogEntry::toString() {
-    return dt::toString(this->time) + " ";
+    string res = dt::toString(this->time) + " ";
+    if (this->kind == LogEntryType::start) {
+        return res + "start";
+    }
+    else if (this->kind == LogEntryType::end) {
+        return res + "end";
+    }
+    else {
+        return res + "log " + this->getNote();
+    }
+}
+
+LogEntryType LogEntry::type() {
+    return this->kind;
 }
 
 dt::time_point LogEntry::getTime() {
     return this->time;
 }
 
-LogEntryLog::LogEntryLog(const string& note)
-  : LogEntry() {
-    this->note = note;
+/* Get the note without copying it. The view is only valid as long as the
+ * LogList the entry came from. */
+std::string_view LogEntry::viewNote() {
+    return this->note;
 }
 
-LogEntryLog::LogEntryLog(const dt::time_point& time, const string& note)
-  : LogEntry(time) {
-    this->note = note;
+/* Append the entry and a line break to the given text. */
+void LogEntry::appendLine(string& out) {
+    char buff[dt::FORMATSIZE];
+    out.append(buff, dt::formatDate(buff, this->time) - buff);
+    if (this->kind == LogEntryType::start) {
+        out += " start\n";
+    }
+    else if (this->kind == LogEntryType::end) {
+        out += " end\n";
+    }
+    else {
+        out += " log ";
+        out += this->note;
+        out += '\n';
+    }
 }
 
-string LogEntryLog::getNote() {
-    return this->note;
+/* Copy the note. */
+string LogEntry::getNote() {
+    return string(this->note);
 }
 
-/* Parse one line of a file and recreate the LogEntry. */
-LogEntry * LogEntry::parse(const string& str) {
+/* Recreate the LogEntry from one line of a file, whose date was already
+ * parsed. Notes refer to the given line. */
+LogEntry LogEntry::parse(std::string_view str, const dt::time_point& time) {
     // The format is 'dd.mm.YYYY hh:mm:ss <command> <args...>'
-    dt::time_point time;
-    try {
-        time = dt::parseDateStr(str.substr(0, dt::DATESIZE));
-    } catch(dt::DateFormatException& ex) {
-        throw CorruptedFileException(
-            "Could not parse date "+str.substr(0, dt::DATESIZE));
-    }
     if (str.size() < dt::DATESIZE + 1) {
         throw CorruptedFileException("Empty line after date");
     }
-    string content = str.substr(dt::DATESIZE + 1);
+    std::string_view content = str.substr(dt::DATESIZE + 1);
     if (content.compare("start") == 0) {
-        return new LogEntryStart(time);
+        return LogEntry(LogEntryType::start, time, std::string_view());
     }
     else if (content.compare("end") == 0) {
-        return new LogEntryEnd(time);
+        return LogEntry(LogEntryType::end, time, std::string_view());
     }
     else if (content.compare(0,4,"log ") == 0) {
-        string msg = content.substr(4);
-        return new LogEntryLog(time, msg);
+        return LogEntry(LogEntryType::log, time, content.substr(4));
     }
     else {
-        throw CorruptedFileException("Unknown log entry "+content);
+        throw CorruptedFileException("Unknown log entry "+string(content));
+    }
+}
+
+
+StringPool::StringPool() {
+    this->used = 0;
+    this->end = 0;
+}
+
+/* Add memory that is owned by someone else. Returns the offset of its
+ * beginning. */
+size_t StringPool::addExternal(const char *data, size_t size) {
+    Block block{this->end, (char *) data, size, false};
+    this->blocks.push_back(block);
+    this->end += size;
+    return block.base;
+}
+
+/* Copy a string into the pool. Returns its offset. Strings are added back
+ * to back, so the offsets of new strings follow each other without gaps. */
+size_t StringPool::add(std::string_view str) {
+    const size_t BLOCKSIZE = 64 * 1024;
+    if (this->blocks.empty() || !this->blocks.back().owned ||
+                this->blocks.back().size - this->used < str.size()) {
+        size_t size = std::max(BLOCKSIZE, str.size());
+        Block block{this->end, new char[size], size, true};
+        this->blocks.push_back(block);
+        this->used = 0;
     }
+    Block& block = this->blocks.back();
+    memcpy(block.data + this->used, str.data(), str.size());
+    this->used += str.size();
+    this->end += str.size();
+    return this->end - str.size();
 }
 
-string LogEntryStart::toString() {
-    string res = LogEntry::toString();
-    return res + "start";
+/* Get a string by its offset and length. */
+std::string_view StringPool::get(size_t offset, size_t length) {
+    if (length == 0) {
+        return std::string_view();
+    }
+    // Usually there is only the mapped file and maybe one block of new notes.
+    size_t i = this->blocks.size() - 1;
+    while (this->blocks[i].base > offset) {
+        i--;
+    }
+    const Block& block = this->blocks[i];
+    return std::string_view(block.data + (offset - block.base), length);
+}
+
+/* The offset behind the last string. */
+size_t StringPool::size() {
+    return this->end;
+}
+
+/* Copy everything from the given offset to the end. */
+string StringPool::copySince(size_t offset) {
+    string res;
+    for (size_t i=0; i<this->blocks.size(); i++) {
+        const Block& block = this->blocks[i];
+        // Each block ends where the next one starts.
+        size_t blockEnd = i+1 < this->blocks.size() ?
+                this->blocks[i+1].base : this->end;
+        if (blockEnd <= offset)
+            continue;
+        size_t from = std::max(offset, block.base);
+        res.append(block.data + (from - block.base), blockEnd - from);
+    }
+    return res;
 }
 
-string LogEntryEnd::toString() {
-    string res = LogEntry::toString();
-    return res + "end";
+StringPool::~StringPool() {
+    for (Block& block : this->blocks) {
+        if (block.owned) {
+            delete[] block.data;
+        }
+    }
 }
 
-string LogEntryLog::toString() {
-    string res = LogEntry::toString();
-    return res + "log " + this->note;
+
+size_t EntryColumns::size() {
+    return this->times.size();
 }
 
+void EntryColumns::reserve(size_t count) {
+    this->times.reserve(count);
+    this->types.reserve(count);
+    this->noteOffsets.reserve(count);
+    this->noteLengths.reserve(count);
+}
+
+void EntryColumns::push(LogEntryType type, const dt::time_point& time,
+                        size_t noteOffset, uint32_t noteLength) {
+    this->times.push_back(time);
+    this->types.push_back(type);
+    this->noteOffsets.push_back(noteOffset);
+    this->noteLengths.push_back(noteLength);
+}
 
-/* Parse the log file. */
-LogList::LogList(std::fstream *filestream) {
+void EntryColumns::pop() {
+    this->times.pop_back();
+    this->types.pop_back();
+    this->noteOffsets.pop_back();
+    this->noteLengths.pop_back();
+}
+
+void EntryColumns::append(const EntryColumns& other) {
+    this->times.insert(this->times.end(),
+                       other.times.begin(), other.times.end());
+    this->types.insert(this->types.end(),
+                       other.types.begin(), other.types.end());
+    this->noteOffsets.insert(this->noteOffsets.end(),
+                       other.noteOffsets.begin(), other.noteOffsets.end());
+    this->noteLengths.insert(this->noteLengths.end(),
+                       other.noteLengths.begin(), other.noteLengths.end());
+}
+
+void EntryColumns::swap(EntryColumns& other) {
+    this->times.swap(other.times);
+    this->types.swap(other.types);
+    this->noteOffsets.swap(other.noteOffsets);
+    this->noteLengths.swap(other.noteLengths);
+}
+
+
+/* Tell whether there are logs in the given directory. */
+bool LogList::existsIn(const string& path) {
+    return access((path + "/manifest").c_str(), F_OK) == 0 ||
+           access((path + "/logs").c_str(), F_OK) == 0 ||
+           access((path + "/logs.bin").c_str(), F_OK) == 0;
+}
+
+/* Tell whether a change to the logs in the given directory was interrupted
+ * and is completed from the journal when they are opened. */
+bool LogList::needsRecovery(const string& path) {
+    return access((path + "/journal").c_str(), F_OK) == 0;
+}
+
+/* Map and parse the logs in the given directory, in whatever format they
+ * are. If recentOnly is set, only the entries since the last start might be
+ * read. */
+LogList::LogList(const string& path, bool recentOnly) {
+    ProfileScope scope(Phase::read);
+    this->path = path;
     this->needsToBeWritten = 0;
+    this->amended = SIZE_MAX;
     this->active = false;
-    this->file = filestream;
+    this->begin = 0;
+    this->firstEntry = 0;
+    this->complete = true;
+    this->fd = -1;
+    this->notesFd = -1;
+    this->savedNotes = 0;
+    this->endMoved = false;
+    this->rollups.setFile(path + "/rollups");
+    this->searchIndex.setFile(path + "/search");
+    recoverJournal(path);
+    
+    if (access((path + "/logs.bin").c_str(), F_OK) == 0) {
+        this->format = LogFormat::binary;
+        this->fd = open((path + "/logs.bin").c_str(), O_RDWR);
+        this->notesFd = open((path + "/logs.notes").c_str(), O_RDWR);
+        if (this->fd < 0 || this->notesFd < 0) {
+            if (this->fd >= 0)
+                close(this->fd);
+            if (this->notesFd >= 0)
+                close(this->notesFd);
+            throw CorruptedFileException("Could not open a logs file");
+        }
+        // Everything can be read at once, so there is no need to skip
+        // anything.
+        this->loadBinary();
+        this->updateActive();
+        this->stamps = this->stampFiles();
+        return;
+    }
     
-    string line;
-    while(std::getline(*filestream, line) && !line.empty()) {
-        LogEntry *newEntry = LogEntry::parse(line);
-        if (newEntry->type() == LogEntryType::start) {
-            this->active = true;
+    this->format = LogFormat::text;
+    this->openSegments();
+    this->loadRecent();
+    if (! recentOnly) {
+        this->loadAll();
+    }
+    this->updateActive();
+    this->stamps = this->stampFiles();
+}
+
+/* Stamp the files that hold the entries. Entries are only added to the
+ * newest segment, but older ones might be edited by hand. */
+vector<FileStamp> LogList::stampFiles() {
+    vector<FileStamp> res;
+    if (this->format == LogFormat::binary) {
+        res.push_back(stampFile(this->path + "/logs.bin"));
+        res.push_back(stampFile(this->path + "/logs.notes"));
+    }
+    else {
+        res.push_back(stampFile(this->path + "/manifest"));
+        for (const Segment& segment : this->segments) {
+            res.push_back(stampFile(this->path + "/" + segment.name));
         }
-        else if (newEntry->type() == LogEntryType::end) {
-            this->active = false;
+    }
+    return res;
+}
+
+/* Tell whether the files were changed by someone else since they were
+ * read. */
+bool LogList::isOutdated() {
+    return this->stampFiles() != this->stamps;
+}
+
+LogFormat LogList::getFormat() {
+    return this->format;
+}
+
+/* Append a new entry and update the state. The note is copied. */
+void LogList::addEntry(LogEntryType type, const dt::time_point& time,
+                       std::string_view note) {
+    size_t offset = note.empty() ? 0 : this->notes.add(note);
+    this->entries.push(type, time, offset, note.size());
+    if (type == LogEntryType::start) {
+        this->active = true;
+    }
+    else if (type == LogEntryType::end) {
+        this->active = false;
+    }
+}
+
+/* Set the state from the last start or end. */
+void LogList::updateActive() {
+    const vector<LogEntryType>& types = this->entries.types;
+    this->active = false;
+    for (size_t i=types.size(); i>0; i--) {
+        if (types[i-1] != LogEntryType::log) {
+            this->active = types[i-1] == LogEntryType::start;
+            break;
         }
-        this->entries.push_back(newEntry);
     }
 }
 
-/* Perform checks on the logfile. */
-void LogList::check() {
-    bool active = false;
-    for (LogEntry *entry : this->entries) {
-        if (entry->type() == LogEntryType::start) {
-            if (active)
-                throw CorruptedFileException("Two starts without end");
-            active = true;
+/* Parse the lines of a segment between the given offsets and append the
+ * entries to the given columns. An empty line ends the list. */
+void LogList::parseRange(size_t segment, size_t from, size_t to,
+                         EntryColumns& res) {
+    vector<ParseTask> ranges(1);
+    ranges[0].segment = segment;
+    ranges[0].from = from;
+    ranges[0].to = to;
+    this->parseRanges(ranges, res);
+}
+
+/* Parse the given ranges of segments and append their entries in order. */
+void LogList::parseRanges(vector<ParseTask>& ranges, EntryColumns& res) {
+    this->streamRanges(ranges, [&res](EntryColumns& piece) {
+        res.append(piece);
+    });
+}
+
+/* Parse the given ranges of segments and hand their entries over in order,
+ * piece by piece. Large ranges are split at line ends. One piece per core
+ * is parsed at a time, each by its own thread, so only these pieces are
+ * held in memory. */
+void LogList::streamRanges(vector<ParseTask>& ranges,
+                           const std::function<void(EntryColumns&)>& consume) {
+    // Ranges are split into pieces of about this size.
+    const size_t PIECESIZE = 1 << 19;
+    
+    vector<ParseTask> tasks;
+    // The range each piece belongs to
+    vector<size_t> owners;
+    for (size_t i=0; i<ranges.size(); i++) {
+        // Segments are mapped before the threads start, this is not thread
+        // safe.
+        size_t segment = ranges[i].segment;
+        const char *data = this->mapSegment(segment)->getData();
+        size_t pos = ranges[i].from;
+        while (pos < ranges[i].to) {
+            size_t end = ranges[i].to;
+            if (end - pos > PIECESIZE) {
+                const char *newline = (const char *) memchr(
+                        data + pos + PIECESIZE, '\n', end - pos - PIECESIZE);
+                if (newline)
+                    end = newline - data + 1;
+            }
+            tasks.emplace_back();
+            ParseTask& task = tasks.back();
+            task.segment = segment;
+            task.data = data;
+            task.base = this->segmentBases[segment];
+            task.from = pos;
+            task.to = end;
+            task.stopped = false;
+            task.skipLogs = ranges[i].skipLogs;
+            owners.push_back(i);
+            pos = end;
         }
-        else if (entry->type() == LogEntryType::end) {
-            if (! active)
-                throw CorruptedFileException("Two ends without start");
-            active = false;
+    }
+    
+    size_t threads = std::max((size_t) std::thread::hardware_concurrency(),
+                              (size_t) 1);
+    // Pieces behind an empty line are not part of the list, even if they
+    // could not be parsed.
+    size_t stoppedRange = ranges.size();
+    for (size_t round=0; round<tasks.size(); round+=threads) {
+        size_t roundEnd = std::min(round + threads, tasks.size());
+        {
+            ProfileScope scope(Phase::parse);
+            std::atomic<size_t> next(round);
+            auto work = [&tasks, &next, roundEnd]() {
+                size_t i;
+                while ((i = next++) < roundEnd) {
+                    LogList::parseTask(tasks[i]);
+                }
+            };
+            vector<std::thread> workers;
+            for (size_t i=round+1; i<roundEnd; i++) {
+                workers.emplace_back(work);
+            }
+            work();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+        for (size_t i=round; i<roundEnd; i++) {
+            if (owners[i] == stoppedRange)
+                continue;
+            if (tasks[i].error)
+                std::rethrow_exception(tasks[i].error);
+            Profiler::linesParsed += tasks[i].entries.size();
+            Profiler::bytesRead += tasks[i].to - tasks[i].from;
+            consume(tasks[i].entries);
+            EntryColumns().swap(tasks[i].entries);
+            if (tasks[i].stopped)
+                stoppedRange = owners[i];
         }
     }
-    for (int i=0; i<this->entries.size()-1; i++) {
-        if ( this->entries[i]->getTime() > this->entries[i+1]->getTime() ) {
-            throw CorruptedFileException("Entries not sorted");
+}
+
+/* Parse the lines of a task. Errors are kept in the task, so that they can
+ * be thrown by the thread that joins the tasks. */
+void LogList::parseTask(ParseTask& task) {
+    // Dates are parsed in chunks to make use of the batch parser.
+    const size_t CHUNKSIZE = 256;
+    std::string_view lines[CHUNKSIZE];
+    const char *dates[CHUNKSIZE];
+    dt::time_point times[CHUNKSIZE];
+    
+    const char *data = task.data;
+    size_t to = task.to;
+    size_t pos = task.from;
+    try {
+        while (pos < to) {
+            size_t count = 0;
+            while (count < CHUNKSIZE && pos < to) {
+                const char *lineBegin = data + pos;
+                const char *lineEnd = (const char *) memchr(lineBegin, '\n',
+                                                            to - pos);
+                if (! lineEnd) {
+                    lineEnd = data + to;
+                }
+                if (lineEnd == lineBegin) {
+                    to = pos;
+                    task.stopped = true;
+                    break;
+                }
+                // Neither the date nor the note of a skipped log is read.
+                if (task.skipLogs &&
+                            lineEnd - lineBegin >= (ptrdiff_t) dt::DATESIZE + 5
+                            && memcmp(lineBegin + dt::DATESIZE + 1, "log ", 4)
+                            == 0) {
+                    pos = lineEnd - data + 1;
+                    continue;
+                }
+                lines[count] = std::string_view(lineBegin,
+                                                lineEnd - lineBegin);
+                if (lines[count].size() < dt::DATESIZE) {
+                    throw CorruptedFileException(
+                        "Could not parse date "+string(lines[count]));
+                }
+                dates[count] = lineBegin;
+                count++;
+                pos = lineEnd - data + 1;
+            }
+            size_t parsed = dt::parseDateStrs(dates, count, times);
+            if (parsed < count) {
+                throw CorruptedFileException("Could not parse date "
+                        +string(lines[parsed].substr(0, dt::DATESIZE)));
+            }
+            for (size_t i=0; i<count; i++) {
+                LogEntry entry = LogEntry::parse(lines[i], times[i]);
+                std::string_view note = entry.viewNote();
+                size_t offset = note.empty() ?
+                        0 : task.base + (note.data() - data);
+                task.entries.push(entry.type(), times[i], offset,
+                                  note.size());
+            }
         }
+    } catch (...) {
+        task.error = std::current_exception();
     }
 }
 
-/* If an entry is added, it can be appended to the file. If the file has to be
- * rewritten, keep it that way. */
+/* Search the newest segment backwards for the last start and parse only
+ * the entries from there on. As sessions do not span segments, nothing
+ * before is needed to know the current state, and its pages are never
+ * touched. */
+void LogList::loadRecent() {
+    if (this->segments.empty())
+        return;
+    size_t newest = this->segments.size() - 1;
+    MappedFile *mapping = this->mapSegment(newest);
+    const char *data = mapping->getData();
+    size_t size = mapping->getSize();
+    // End of the next line to look at, without the newline.
+    size_t lineEnd = size;
+    while (true) {
+        const char *newline = lineEnd == 0 ?
+                nullptr : (const char *) memrchr(data, '\n', lineEnd);
+        size_t lineBegin = newline ? newline - data + 1 : 0;
+        if (lineEnd - lineBegin == dt::DATESIZE + 6 &&
+                memcmp(data + lineBegin + dt::DATESIZE + 1, "start", 5) == 0) {
+            this->begin = lineBegin;
+            break;
+        }
+        if (lineBegin == 0) {
+            break;
+        }
+        lineEnd = lineBegin - 1;
+    }
+    this->parseRange(newest, this->begin, size, this->entries);
+    this->complete = newest == 0 && this->begin == 0;
+}
+
+/* Parse the entries before the recent ones, if they were skipped. */
+void LogList::loadAll() {
+    if (this->complete)
+        return;
+    EntryColumns recent;
+    recent.swap(this->entries);
+    size_t newest = this->segments.size() - 1;
+    vector<ParseTask> ranges(newest + 1);
+    for (size_t i=0; i<=newest; i++) {
+        ranges[i].segment = i;
+        ranges[i].from = 0;
+        ranges[i].to = i < newest ? this->mapSegment(i)->getSize() :
+                                    this->begin;
+    }
+    this->parseRanges(ranges, this->entries);
+    this->firstEntry = this->entries.size();
+    this->entries.append(recent);
+    // The positions of the entries moved.
+    this->sessions.clear();
+    // The recent entries start with a start, so the state is not changed.
+    this->complete = true;
+}
+
+/* Tell whether all entries were read. */
+bool LogList::isComplete() {
+    return this->complete;
+}
+
+/* Perform checks on the logfile. If the part that was checked before is
+ * unchanged, only the entries behind it are checked. Otherwise all entries
+ * are read and checked. */
+void LogList::check() {
+    ProfileScope scope(Phase::check);
+    Checkpoint point;
+    if (this->readCheckpoint(point) && this->checkSince(point)) {
+        this->writeCheckpoint(point);
+        return;
+    }
+    this->loadAll();
+    bool active = false;
+    dt::time_point last = dt::time_point::min();
+    LogList::checkEntries(this->entries, 0, active, last);
+    // The rollups are derived from the entries, so they are simply
+    // rebuilt.
+    this->rebuildRollups();
+    this->writeCheckpoint(this->checkpointAtEnd(active, last));
+}
+
+/* If an entry is added, it can be appended to the file. */
 void LogList::updateFileState() {
-    if (this->needsToBeWritten != -1)
-        this->needsToBeWritten += 1;
+    this->needsToBeWritten += 1;
+}
+
+/* Make sure an entry at the given time does not come before the last one.
+ * The files have to stay sorted. */
+void LogList::checkOrder(const dt::time_point& time) {
+    if (this->entries.size() > 0 && time < this->entries.times.back())
+        throw SituationalMistake("Entries have to be in chronological order");
+}
+
+/* Replace the last entry by one of the same type at the given time. If the
+ * old one was written already, it is replaced in the file. */
+void LogList::replaceLast(const dt::time_point& time) {
+    size_t last = this->entries.size() - 1;
+    if (last > 0 && time < this->entries.times[last - 1])
+        throw SituationalMistake("Entries have to be in chronological order");
+    LogEntryType type = this->entries.types.back();
+    this->sessions.forget(last);
+    this->entries.pop();
+    this->addEntry(type, time, std::string_view());
+    if (this->needsToBeWritten == 0)
+        this->amended = std::min(this->amended, this->entries.size() - 1);
 }
 
 bool LogList::isActive() {
@@ -132,144 +588,495 @@ bool LogList::isActive() {
 }
 
 void LogList::start(bool again) {
+    this->start(again, dt::now());
+}
+
+void LogList::start(bool again, const dt::time_point& time) {
     if (!this->active) {
-        this->entries.push_back( new LogEntryStart() );
-        this->active = true;
+        this->checkOrder(time);
+        this->addEntry(LogEntryType::start, time, std::string_view());
         this->updateFileState();
     }
     else if (!again) {
         throw SituationalMistake("Already started");
     }
-    else if (this->getLastEntry()->type() != LogEntryType::start) {
+    else if (this->getLastEntry().type() != LogEntryType::start) {
         throw SituationalMistake(
                 "Cannot move start if something was noted in between." );
     }
     else {
-        LogEntry *oldstart = this->entries.back();
-        this->entries.pop_back();
-        delete oldstart;
-        this->entries.push_back( new LogEntryStart() );
-        this->needsToBeWritten = -1;
+        this->replaceLast(time);
     }
 }
 
 void LogList::log(string note) {
+    this->log(note, dt::now());
+}
+
+void LogList::log(string note, const dt::time_point& time) {
     if (! this->active)
         throw SituationalMistake("Log is only enabled during work");
-    this->entries.push_back(
-        new LogEntryLog(note) );
+    this->checkOrder(time);
+    this->addEntry(LogEntryType::log, time, note);
     this->updateFileState();
 }
 
 void LogList::end(bool again) {
+    this->end(again, dt::now());
+}
+
+void LogList::end(bool again, const dt::time_point& time) {
     if (this->active) {
-        this->entries.push_back( new LogEntryEnd() );
-        this->active = false;
+        this->checkOrder(time);
+        this->addEntry(LogEntryType::end, time, std::string_view());
         this->updateFileState();
+        if (this->sessions.isBuilt())
+            this->sessions.update(this->entries);
     }
-    else if (!again) {
+    else if (!again || this->entries.size() == 0) {
+        // Without any entry, there is no end to move either.
         throw SituationalMistake("Not started");
     }
     else {
-        LogEntry *oldend = this->entries.back();
-        this->entries.pop_back();
-        delete oldend;
-        this->entries.push_back( new LogEntryEnd() );
-        this->needsToBeWritten = -1;
+        dt::time_point old = this->entries.times.back();
+        this->replaceLast(time);
+        // The rollups still count the end as it is in the file.
+        if (! this->endMoved && this->needsToBeWritten == 0) {
+            this->movedEnd = old;
+            this->endMoved = true;
+        }
     }
 }
 
 /* Pick out the entries between the given dates. */
-vector<LogEntry *> LogList::list(dt::time_point& from, dt::time_point& to,
-                                      bool& includeLogs) {
-    vector<LogEntry *> res;
-    for (LogEntry *e : this->entries) {
-        if ((e->getTime() > from) && (e->getTime() < to)) {
-            if (e->type() == LogEntryType::start ||
-                                e->type() == LogEntryType::end)
-                res.push_back(e);
-            if (e->type() == LogEntryType::log && includeLogs)
-                    res.push_back(e);
+vector<LogEntry> LogList::list(dt::time_point& from, dt::time_point& to,
+                                    bool& includeLogs) {
+    vector<LogEntry> res;
+    this->scan(from, to, includeLogs, [&res](LogEntry& entry) {
+        res.push_back(entry);
+    });
+    return res;
+}
+
+/* Hand the entries between the given dates over one by one, in order. If
+ * not all entries were read, only the parts of the segments that hold the
+ * given time are parsed, a few pieces at a time, and nothing is kept. Logs
+ * that are not included are not parsed at all then. */
+void LogList::scan(dt::time_point& from, dt::time_point& to,
+                   bool& includeLogs,
+                   const std::function<void(LogEntry&)>& visit) {
+    ProfileScope scope(Phase::query);
+    if (this->isComplete()) {
+        this->pick(this->entries, from, to, includeLogs, visit);
+        return;
+    }
+    vector<ParseTask> ranges;
+    size_t newest = this->segments.size() - 1;
+    for (size_t i=0; i<=newest; i++) {
+        // The manifest only knows where the newest segment begins.
+        const Segment& segment = this->segments[i];
+        if (segment.first >= to || (i < newest && segment.last <= from))
+            continue;
+        MappedFile *mapping = this->mapSegment(i);
+        const char *data = mapping->getData();
+        size_t size = mapping->getSize();
+        TimeIndex segmentIndex;
+        TimeIndex& index = i == newest ? this->index : segmentIndex;
+        index.setFile(this->path + "/" + segment.name + ".idx");
+        size_t first = 0;
+        size_t end = size;
+        if (index.prepare(data, size)) {
+            first = index.findFirst(dt::toDayNumber(from));
+            end = index.findEnd(dt::toDayNumber(to), size);
+        }
+        if (first < end) {
+            ranges.emplace_back();
+            ranges.back().segment = i;
+            ranges.back().from = first;
+            ranges.back().to = end;
+            ranges.back().skipLogs = ! includeLogs;
+        }
+    }
+    this->streamRanges(ranges, [&](EntryColumns& piece) {
+        this->pick(piece, from, to, includeLogs, visit);
+    });
+}
+
+/* The time worked between the given dates by the sessions that were ended.
+ * Sessions at the edges are cut off there. If the entries that were read
+ * hold all sessions since the given date, the time is taken from the table
+ * of sessions. Otherwise whole days in between are taken from the rollups,
+ * so only the entries of the first and the last day are read. */
+dt::duration LogList::workedTime(dt::time_point& from, dt::time_point& to) {
+    ProfileScope scope(Phase::query);
+    bool includeLogs = false;
+    this->sessions.update(this->entries);
+    if (this->isComplete() || this->sessions.reaches(from))
+        return this->sessions.worked(from, to);
+    if (! this->prepareRollups()) {
+        this->rebuildRollups();
+        this->sessions.update(this->entries);
+        return this->sessions.worked(from, to);
+    }
+    int64_t firstDay = dt::toDayNumber(from) + 1;
+    int64_t lastDay = dt::toDayNumber(to) - 1;
+    if (firstDay > lastDay) {
+        vector<LogEntry> entries = this->list(from, to, includeLogs);
+        return this->workedIn(entries, from, to);
+    }
+    dt::time_point middleBegin = dt::beginOfDayNumber(firstDay);
+    dt::time_point middleEnd = dt::beginOfDayNumber(lastDay + 1);
+    vector<LogEntry> head = this->list(from, middleBegin, includeLogs);
+    vector<LogEntry> tail = this->list(middleEnd, to, includeLogs);
+    return this->workedIn(head, from, middleBegin) +
+           this->rollups.sum(firstDay, lastDay) +
+           this->workedIn(tail, middleEnd, to);
+}
+
+/* Tell whether a session runs at the given time and when it began. The
+ * entries before the time are read a day at first, and further back while
+ * there is no start or end among them. */
+bool LogList::runningAt(const dt::time_point& time, dt::time_point& begun) {
+    const vector<dt::time_point>& times = this->entries.times;
+    const vector<LogEntryType>& types = this->entries.types;
+    // The recent entries begin with a start, so they are enough if they
+    // reach back to the time.
+    if (this->isComplete() || (! times.empty() && times.front() <= time)) {
+        size_t i = std::upper_bound(times.begin(), times.end(), time) -
+                   times.begin();
+        while (i > 0 && types[i-1] == LogEntryType::log)
+            i--;
+        if (i == 0)
+            return false;
+        begun = times[i-1];
+        return types[i-1] == LogEntryType::start;
+    }
+    dt::time_point earliest = this->segments.front().first;
+    // The range of scan leaves out its edges.
+    dt::time_point to = time + dt::duration(1);
+    bool includeLogs = false;
+    for (dt::duration window = dt::hours(24); ; window *= 2) {
+        dt::time_point from = time - window;
+        bool found = false;
+        bool running = false;
+        this->scan(from, to, includeLogs, [&](LogEntry& e) {
+            found = true;
+            running = e.type() == LogEntryType::start;
+            begun = e.getTime();
+        });
+        if (found)
+            return running;
+        if (from <= earliest)
+            return false;
+    }
+}
+
+/* Sum up the sessions of some entries between the given dates. A session
+ * that runs at the beginning of the range is looked up before it, so it is
+ * counted even if none of its entries are in the range. */
+dt::duration LogList::workedIn(vector<LogEntry>& entries,
+                               const dt::time_point& from,
+                               const dt::time_point& to) {
+    dt::duration res = dt::seconds(0);
+    dt::time_point since = from;
+    dt::time_point begun;
+    bool running = this->runningAt(from, begun);
+    for (LogEntry& e : entries) {
+        if (e.type() == LogEntryType::start) {
+            since = e.getTime();
+            begun = since;
+            running = true;
+        }
+        else if (e.type() == LogEntryType::end) {
+            if (running)
+                res += e.getTime() - since;
+            running = false;
         }
     }
+    // The current session is not counted until it is ended.
+    if (running &&
+                ! (this->active && begun == this->getLastStart().getTime()))
+        res += to - since;
     return res;
 }
 
-LogEntry * LogList::getLastEntry() {
-    return this->entries.back();
+/* Collect the sessions between the given dates in one pass, as their
+ * beginnings and ends in seconds. Sessions at the edges are cut off there
+ * and, as in workedIn, the current session is not counted until it is
+ * ended. */
+void LogList::sessionsIn(dt::time_point& from, dt::time_point& to,
+                         vector<int64_t>& begins, vector<int64_t>& ends) {
+    bool includeLogs = false;
+    int64_t since = dt::to_time_t(from);
+    dt::time_point begun;
+    bool running = this->runningAt(from, begun);
+    this->scan(from, to, includeLogs, [&](LogEntry& e) {
+        if (e.type() == LogEntryType::start) {
+            since = dt::to_time_t(e.getTime());
+            begun = e.getTime();
+            running = true;
+        }
+        else if (e.type() == LogEntryType::end) {
+            if (running) {
+                begins.push_back(since);
+                ends.push_back(dt::to_time_t(e.getTime()));
+            }
+            running = false;
+        }
+    });
+    if (running && ! (this->active &&
+                begun == this->getLastStart().getTime())) {
+        begins.push_back(since);
+        ends.push_back(dt::to_time_t(to));
+    }
+}
+
+/* Read the rollups and tell whether they count all sessions that were
+ * ended. They have to be counted from the files as they are, so changes by
+ * hand to older entries are noticed too. */
+bool LogList::prepareRollups() {
+    if (! this->rollups.read() ||
+            this->rollups.getSource() != digestStamps(this->stamps))
+        return false;
+    const vector<LogEntryType>& types = this->entries.types;
+    const vector<dt::time_point>& times = this->entries.times;
+    int64_t through = this->rollups.getThrough();
+    for (size_t i=types.size(); i>0; i--) {
+        if (types[i-1] == LogEntryType::end)
+            return through == dt::clock::to_time_t(times[i-1]);
+        if (types[i-1] == LogEntryType::start)
+            return through <= dt::clock::to_time_t(times[i-1]);
+    }
+    return through == INT64_MIN;
+}
+
+/* Count all sessions again. */
+void LogList::rebuildRollups() {
+    this->loadAll();
+    this->rollups.clear();
+    const vector<LogEntryType>& types = this->entries.types;
+    const vector<dt::time_point>& times = this->entries.times;
+    size_t start = types.size();
+    for (size_t i=0; i<types.size(); i++) {
+        if (types[i] == LogEntryType::start) {
+            start = i;
+        }
+        else if (types[i] == LogEntryType::end && start < i) {
+            this->rollups.addSession(times[start], times[i]);
+        }
+    }
+    this->rollups.setSource(digestStamps(this->stamps));
+    this->rollups.write();
+}
+
+/* Count the sessions that were ended since the logs were read and note the
+ * files as they were written. If there are no rollups yet, or they were not
+ * counted from the files before, they are built when they are needed. */
+void LogList::updateRollups(uint64_t before) {
+    const vector<LogEntryType>& types = this->entries.types;
+    const vector<dt::time_point>& times = this->entries.times;
+    size_t first = this->needsToBeWritten > 0 ?
+            types.size() - this->needsToBeWritten : types.size();
+    uint64_t after = digestStamps(this->stamps);
+    if (after == before || ! this->rollups.read() ||
+            this->rollups.getSource() != before)
+        return;
+    if (this->endMoved) {
+        this->rollups.moveEnd(this->getLastStart().getTime(),
+                              this->movedEnd, this->getLastEntry().getTime());
+        this->endMoved = false;
+    }
+    size_t start = types.size();
+    for (size_t i=first; i>0; i--) {
+        if (types[i-1] == LogEntryType::start) {
+            start = i-1;
+            break;
+        }
+    }
+    for (size_t i=first; i<types.size(); i++) {
+        if (types[i] == LogEntryType::start) {
+            start = i;
+        }
+        else if (types[i] == LogEntryType::end && start < i) {
+            this->rollups.addSession(times[start], times[i]);
+        }
+    }
+    this->rollups.setSource(after);
+    this->rollups.write();
 }
 
-LogEntryStart * LogList::getLastStart() {
-    vector<LogEntry *>::reverse_iterator res;
-    res = this->entries.rbegin();
-    while (res != this->entries.rend()) {
-        if ((*res)->type() == LogEntryType::start) {
-            return (LogEntryStart *) (*res);
+/* Hand over views on the entries of the columns between the given
+ * dates. */
+void LogList::pick(EntryColumns& columns, dt::time_point& from,
+                   dt::time_point& to, bool& includeLogs,
+                   const std::function<void(LogEntry&)>& visit) {
+    const vector<dt::time_point>& times = columns.times;
+    const vector<LogEntryType>& types = columns.types;
+    for (size_t i=0; i<times.size(); i++) {
+        if ((times[i] > from) && (times[i] < to)) {
+            if (types[i] != LogEntryType::log || includeLogs) {
+                LogEntry entry = this->getEntry(columns, i);
+                visit(entry);
+            }
+        }
+    }
+}
+
+size_t LogList::size() {
+    return this->entries.size();
+}
+
+/* Get a view on the entry at the given position. */
+LogEntry LogList::getEntry(size_t i) {
+    return this->getEntry(this->entries, i);
+}
+
+/* Get a view on an entry of some columns whose notes are in the pool. */
+LogEntry LogList::getEntry(EntryColumns& columns, size_t i) {
+    return LogEntry(columns.types[i], columns.times[i],
+            this->notes.get(columns.noteOffsets[i], columns.noteLengths[i]));
+}
+
+LogEntry LogList::getLastEntry() {
+    return this->getEntry(this->entries.size() - 1);
+}
+
+LogEntry LogList::getLastStart() {
+    const vector<LogEntryType>& types = this->entries.types;
+    for (size_t i=types.size(); i>0; i--) {
+        if (types[i-1] == LogEntryType::start) {
+            return this->getEntry(i-1);
         }
-        ++res;
     }
     throw SituationalMistake("No start found");
 }
 
 /* Write this object to the file it was created from. */
 void LogList::save() {
-    if (this->needsToBeWritten == -1) {
-        // rewrite all
-        this->file->clear();
-        this->file->seekp(0);
-        for (LogEntry *entry : this->entries) {
-            (*this->file) << entry->toString() << std::endl;
+    if (this->format == LogFormat::binary)
+        this->saveBinary();
+    else
+        this->saveText();
+    uint64_t before = digestStamps(this->stamps);
+    this->stamps = this->stampFiles();
+    this->updateRollups(before);
+    this->updateSearchIndex();
+    this->needsToBeWritten = 0;
+    this->amended = SIZE_MAX;
+    this->endMoved = false;
+}
+
+/* Write the changes to the newest segment and keep its index up to date. A
+ * start in a new month begins a new segment. A changed entry is always the
+ * last one in the file, so only the tail of the file is replaced. */
+void LogList::saveText() {
+    size_t size = this->entries.size();
+    size_t first = std::min(this->amended, size - this->needsToBeWritten);
+    if (first >= size)
+        return;
+    string out;
+    off_t end = 0;
+    if (this->fd >= 0 && (end = lseek(this->fd, 0, SEEK_END)) < 0) {
+        throw CorruptedFileException("Could not write the log file");
+    }
+    bool replace = this->amended < size;
+    if (replace) {
+        end = this->findLastLine(end);
+    }
+    for (size_t pos = first; pos < size; pos++) {
+        // A changed start stays in its segment.
+        if (pos != this->amended &&
+                    this->entries.types[pos] == LogEntryType::start &&
+                    this->needsNewSegment(this->entries.times[pos])) {
+            if (! out.empty() || replace) {
+                this->writeText(out, end, replace);
+            }
+            this->addSegment(pos);
+            out.clear();
+            end = 0;
+            replace = false;
         }
+        this->getEntry(pos).appendLine(out);
+    }
+    this->writeText(out, end, replace);
+}
+
+/* Write text to the newest segment at the given offset. If it replaces
+ * what is there, the change goes through the journal. */
+void LogList::writeText(const string& text, off_t offset, bool replace) {
+    if (replace) {
+        overwriteTail(this->path, this->segments.back().name, this->fd, text,
+                      offset);
     }
     else {
-        // append last logs
-        this->file->clear();
-        this->file->seekp(0, std::ios_base::end);
-        for (int pos = this->entries.size()-this->needsToBeWritten;
-                                   pos < this->entries.size(); pos++) {
-            (*this->file) << this->entries[pos]->toString() << std::endl;
-        }
+        // The file is opened for appending, so the records go behind
+        // whatever is there as a whole.
+        writeAll(this->fd, text, -1);
+    }
+    this->index.update(text, offset);
+}
+
+/* Find where the last line of the newest segment begins. Only the end of
+ * the file is read. */
+off_t LogList::findLastLine(off_t size) {
+    // Longer than any line of a start or an end
+    const off_t TAILSIZE = 64;
+    off_t from = std::max(size - TAILSIZE, (off_t) 0);
+    char tail[TAILSIZE];
+    Profiler::bytesRead += size - from;
+    if (size == 0 || pread(this->fd, tail, size - from, from) != size - from
+                  || tail[size - from - 1] != '\n') {
+        throw CorruptedFileException("Could not find the last entry");
     }
+    const char *newline = (const char *) memrchr(tail, '\n',
+                                                 size - from - 1);
+    if (newline)
+        return from + (newline - tail) + 1;
+    if (from > 0)
+        throw CorruptedFileException("Could not find the last entry");
+    return 0;
 }
 
 LogList::~LogList() {
-    this->file->flush();
-    this->file->close();
-    delete this->file;
-    
-    for (LogEntry *entry : this->entries) {
-        delete entry;
+    for (MappedFile *mapping : this->segmentMappings) {
+        delete mapping;
     }
-    this->entries.clear();
+    this->mapping.unmap();
+    this->notesMapping.unmap();
+    if (this->fd >= 0)
+        close(this->fd);
+    if (this->notesFd >= 0)
+        close(this->notesFd);
 }
 
-/* Search the path and read in the list of logs. */
-void Joblog::loadLoglist() {
-    if (this->loglist) {
-        // If the Loglist was already loaded, return
-        return;
+/* Search the path and read in the list of logs. If recentOnly is set, only
+ * the current session might be read. Checks read what they need. */
+void Joblog::loadLoglist(bool recentOnly) {
+    // Writers hold the lock until they saved, so that the state they see
+    // stays current. Splitting a single file into segments and completing
+    // the journal rewrite files that other readers might have mapped, so
+    // that is done alone, too.
+    bool alone = this->writing || LogList::needsSplitting(this->getPath()) ||
+                 LogList::needsRecovery(this->getPath());
+    if (! this->locked || (alone && ! this->lock.isExclusive())) {
+        this->lock.acquire(this->getPath(), alone);
+        this->locked = true;
     }
-    std::fstream *filestream = new std::fstream();
-    // If a path was specified, use that one
-    if (! this->path.empty()) {
-        filestream->open(this->path + "/logs", FILEMODE);
+    // Logs that were kept from before are dropped if someone else changed
+    // them meanwhile.
+    if (this->loglist && this->loglist->isOutdated()) {
+        delete this->loglist;
+        this->loglist = nullptr;
     }
-    // Else, search for the default file in parent directories
-    else {
-        string currentFolder = "";
-        string filename = SAVEPATH + "/logs";
-        filestream->open(filename);
-        for (int i=1; i<SEARCHDEPTH && !(*filestream); i++) {
-            currentFolder += "../";
-            filestream->open(currentFolder + filename, FILEMODE);
+    if (this->loglist) {
+        // If the Loglist was already loaded, only read what is missing
+        if (! recentOnly) {
+            this->loglist->loadAll();
         }
-        this->path = currentFolder;
+        return;
     }
-    // Test the file
-    if (! filestream->good())
-        throw CorruptedFileException("Could not open a logs file");
     
-    this->loglist = new LogList(filestream);
+    this->loglist = new LogList(this->path, recentOnly);
     
     if (this->check) {
         loglist->check();
@@ -279,6 +1086,8 @@ void Joblog::loadLoglist() {
 Joblog::Joblog() {
     this->path.clear();
     this->check = false;
+    this->writing = false;
+    this->locked = false;
     this->loglist = nullptr;
 }
 
@@ -286,8 +1095,34 @@ void Joblog::setPath(string path) {
     this->path = path;
 }
 
+/* Get the directory of the logs. If no path was specified, search for the
+ * default directory in parent directories. */
+string Joblog::getPath() {
+    if (this->path.empty()) {
+        ProfileScope scope(Phase::search);
+        string currentFolder = "";
+        for (int i=1; i<SEARCHDEPTH &&
+                    !LogList::existsIn(currentFolder + SAVEPATH); i++) {
+            currentFolder += "../";
+        }
+        this->path = currentFolder + SAVEPATH;
+    }
+    return this->path;
+}
+
+/* Forget the logs, they are read again when they are needed. */
+void Joblog::unload() {
+    if (this->loglist) {
+        delete this->loglist;
+        this->loglist = nullptr;
+    }
+    this->lock.release();
+    this->locked = false;
+    this->writing = false;
+}
+
 /* Create a new directory and the necessary files in it. */
-int Joblog::init() {
+int Joblog::init(LogFormat format) {
     if (this->path.empty()) {
         this->path = SAVEPATH;
     }
@@ -295,28 +1130,42 @@ int Joblog::init() {
     if (res != 0) {
         throw CorruptedFileException("Could not create a directory.");
     }
-    string logfilename = this->path + "/" + "logs";
-    std::ofstream file(logfilename);
-    if (! file.good()) {
-        throw CorruptedFileException("Could not create a log file.");
-    }
+    LogList::create(this->path, format);
     return 0;
 }
 
+/* Lock the logs exclusively when they are loaded, as they are going to be
+ * changed. */
+void Joblog::requestWriting() {
+    this->writing = true;
+}
+
 /* Enforce checking all files that will be used. */
 void Joblog::doChecks() {
     this->check = true;
 }
 
-/* Save all used objects. */
+/* Save all used objects and give up the lock. The logs are kept, so that
+ * they can be used again if nobody changes them. */
 void Joblog::save() {
+    ProfileScope scope(Phase::save);
     if (this->loglist) {
         this->loglist->save();
     }
+    this->lock.release();
+    this->locked = false;
+    this->writing = false;
 }
 
 LogList *Joblog::getLogList() {
-    this->loadLoglist();
+    this->loadLoglist(false);
+    return this->loglist;
+}
+
+/* Get a LogList that might only hold the entries since the last start. This
+ * is enough to add entries and to tell the current state. */
+LogList *Joblog::getRecentLogList() {
+    this->loadLoglist(true);
     return this->loglist;
 }
 
@@ -324,4 +1173,5 @@ Joblog::~Joblog() {
     if (this->loglist) {
         delete this->loglist;
     }
+    this->lock.release();
 }
@@ -0,0 +1,245 @@
+/* Daemon methods
+ *
+ * A daemon serves the logs of one directory over the socket 'socket' in it.
+ * A request is the size of the rest as a 32 bit integer, followed by the
+ * arguments of the command, each terminated by a null byte. The answer is
+ * the output of the command, followed by a single byte with its exit code.
+ * The connection is closed after the answer.
+ */
+
+// Defined with the user interaction methods.
+int parseNormalCommand(Joblog *, vector<string>);
+
+const string SOCKETNAME = "socket";
+// Requests larger than this are not read.
+const uint32_t MAXREQUEST = 1 << 20;
+
+/* Set when the daemon is asked to stop. */
+volatile sig_atomic_t daemonStopping = 0;
+
+void stopDaemon(int) {
+    daemonStopping = 1;
+}
+
+/* Fill the address of the socket in the given directory. Returns false if
+ * the path is too long for a socket address. */
+bool socketAddress(const string& filename, struct sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (filename.size() >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, filename.c_str(), filename.size() + 1);
+    return true;
+}
+
+/* Connect to the socket of a daemon. Returns -1 if none is listening. */
+int connectDaemon(const string& filename) {
+    struct sockaddr_un addr;
+    if (! socketAddress(filename, addr))
+        return -1;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Send all of the given data. Returns false if the other side is gone. */
+bool sendAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t res = send(fd, data, size, MSG_NOSIGNAL);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+/* Receive exactly the given number of bytes. */
+bool receiveAll(int fd, char *data, size_t size) {
+    while (size > 0) {
+        ssize_t res = recv(fd, data, size, 0);
+        if (res < 0 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return false;
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+/* Let a daemon run the command, if one serves the logs in the given
+ * directory. Returns false if there is none, the command has to be run
+ * here then. */
+bool askDaemon(const string& path, const vector<string>& args, int& res) {
+    int fd = connectDaemon(path + "/" + SOCKETNAME);
+    if (fd < 0)
+        return false;
+    string request(4, '\0');
+    for (const string& arg : args) {
+        request += arg;
+        request += '\0';
+    }
+    uint32_t size = request.size() - 4;
+    memcpy(&request[0], &size, 4);
+    if (! sendAll(fd, request.data(), request.size())) {
+        // The daemon quit before it read anything.
+        close(fd);
+        return false;
+    }
+    // The answer is passed on as it arrives. Its last byte is the exit
+    // code, so each chunk keeps back its last byte until the next one.
+    std::cout.flush();
+    OutputBuffer out(STDOUT_FILENO);
+    bool answered = false;
+    char last = 0;
+    char buff[4096];
+    while (true) {
+        ssize_t got = recv(fd, buff, sizeof(buff), 0);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            break;
+        if (answered)
+            out.put(last);
+        out.put(std::string_view(buff, got - 1));
+        last = buff[got - 1];
+        answered = true;
+    }
+    close(fd);
+    if (! answered) {
+        // The command might have been run, so it is not run again.
+        std::cout << "The daemon did not answer." << std::endl;
+        res = 2;
+        return true;
+    }
+    res = (unsigned char) last;
+    return true;
+}
+
+/* Tell whether the daemon runs the given command. Everything else is run
+ * by the command line tool itself, as are lists of other directories. */
+bool isDaemonCommand(const vector<string>& args) {
+    const string& command = args[0];
+    if (command == "list")
+        return args.size() < 2 || args[1] != "--recursive";
+    return command == "start" || command == "end" || command == "log" ||
+           command == "state";
+}
+
+/* Take over the socket in the directory of the logs. */
+Daemon::Daemon(Joblog *joblog) {
+    this->joblog = joblog;
+    string path = joblog->getPath();
+    if (! LogList::existsIn(path))
+        throw CorruptedFileException("No logs found in "+path);
+    this->socketPath = path + "/" + SOCKETNAME;
+    int running = connectDaemon(this->socketPath);
+    if (running >= 0) {
+        close(running);
+        throw SituationalMistake("A daemon is already running");
+    }
+    struct sockaddr_un addr;
+    if (! socketAddress(this->socketPath, addr))
+        throw CorruptedFileException("The path is too long for a socket");
+    // A socket that is left over from a daemon that was killed
+    unlink(this->socketPath.c_str());
+    this->listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (this->listenFd < 0)
+        throw CorruptedFileException("Could not create a socket");
+    // Only the owner may connect. The socket gets its mode when it is bound,
+    // so there is no moment in which others could connect.
+    mode_t mask = umask(0177);
+    int bound = bind(this->listenFd, (struct sockaddr *) &addr, sizeof(addr));
+    umask(mask);
+    if (bound != 0 || listen(this->listenFd, 16) != 0) {
+        close(this->listenFd);
+        throw CorruptedFileException("Could not listen on "+this->socketPath);
+    }
+}
+
+Daemon::~Daemon() {
+    close(this->listenFd);
+    unlink(this->socketPath.c_str());
+}
+
+/* Serve clients until the process is interrupted or terminated. */
+void Daemon::run() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopDaemon;
+    // No SA_RESTART, so that accept returns when a signal arrives.
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Read the logs once in the beginning, requests keep them up to date.
+    this->joblog->getRecentLogList();
+    this->joblog->save();
+
+    while (! daemonStopping) {
+        int client = accept4(this->listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0)
+            continue;
+        this->serve(client);
+        close(client);
+    }
+}
+
+/* Run the command of one client. The output of the command goes straight
+ * into the connection. */
+void Daemon::serve(int client) {
+    // A client that does not send its request does not block the others.
+    struct timeval timeout = {2, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    uint32_t size;
+    if (! receiveAll(client, (char *) &size, 4) || size > MAXREQUEST)
+        return;
+    string request(size, '\0');
+    if (! receiveAll(client, &request[0], size))
+        return;
+    vector<string> args;
+    size_t pos = 0;
+    while (pos < request.size()) {
+        size_t end = request.find('\0', pos);
+        if (end == string::npos)
+            end = request.size();
+        args.push_back(request.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    std::cout.flush();
+    fflush(stdout);
+    int console = dup(STDOUT_FILENO);
+    dup2(client, STDOUT_FILENO);
+    int res = 2;
+    if (args.empty() || ! isDaemonCommand(args)) {
+        std::cout << "The daemon does not run this command." << std::endl;
+    }
+    else {
+        try {
+            res = parseNormalCommand(this->joblog, args);
+            this->joblog->save();
+        } catch (CustomException& ex) {
+            std::cout << "The command failed. The exception message is:\n"
+                         "'" << ex.what() << "'" << std::endl;
+            // Whatever was kept might not match the files anymore.
+            this->joblog->unload();
+            res = 2;
+        }
+    }
+    std::cout.flush();
+    fflush(stdout);
+    dup2(console, STDOUT_FILENO);
+    close(console);
+    char code = (char) res;
+    sendAll(client, &code, 1);
+}
@@ -14,9 +14,13 @@
  *  years
  *  now
  *  parseDateStr
+ *  parseDateStrs
  *  parseDurationStr
  *  to_time_t
  *  to_tm
+ *  formatDate
+ *  formatDay
+ *  formatDuration
  *  toString
  *  toDateString
  *  toClockTimeStr
@@ -24,6 +28,9 @@
  *  getLastMonday
  *  getLastFirstOfMonth
  *  getLastFirstOfYear
+ *  toDayNumber
+ *  parseDayNumber
+ *  beginOfDayNumber
  */
 
 #include <chrono>     // c++ time and date
@@ -31,9 +38,16 @@
 #include <ctime>      // c date & time objects
 #include <iomanip>    // c date & time functions
 #include <string>     // strings
+#include <cstring>    // memcpy
+#include <string_view> // string views
 #include <sstream>    // string stream
 #include <exception>  // exceptions
+#include <vector>     // vector
+#include <algorithm>  // upper_bound
 
+#ifdef __SSE2__
+#include <emmintrin.h> // SSE2 intrinsics
+#endif
 
 #include <iostream>
 
@@ -71,13 +85,15 @@ namespace DateTime {
         return clock::now();
     }
 
-    /* Get a time point from a string. */
-    time_point parseDateStr(const std::string& s) {
+    /* Get a time point from a string using the C library. This accepts
+     * everything std::get_time accepts and is used whenever the fast parser
+     * below does not handle the input. */
+    time_point parseDateStrSlow(std::string_view s) {
         std::tm tm{0};
         // Ignore daylight saving time. This fixes a but where one hour was
         // added to some times, but is probably not consistent for all times.
         tm.tm_isdst = -1;
-        std::istringstream stream(s);
+        std::istringstream stream{std::string(s)};
         stream >> std::get_time(&tm, DATEFORMAT);
         if (stream.fail()) {
             throw DateFormatException();
@@ -86,6 +102,282 @@ namespace DateTime {
         return chrono::system_clock::from_time_t(time_t);
     }
 
+    /* Days since 01.01.1970 of a date in the gregorian calendar. Days beyond
+     * the end of a month carry over into the next one, like mktime does. */
+    long long daysFromCivil(long long y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const long long era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = (unsigned) (y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (long long) doe - 719468;
+    }
+
+    /* Date in the gregorian calendar of a day counted from 01.01.1970. */
+    void civilFromDays(long long day, long long& y, unsigned& m,
+                       unsigned& d) {
+        const long long z = day + 719468;
+        const long long era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = (unsigned) (z - era * 146097);
+        const unsigned yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        y = yoe + era * 400 + (m <= 2);
+    }
+
+    /* Caches the spans of time in which the local time zone has a constant
+     * offset to UTC, so that local times can be converted to time points
+     * with integer arithmetic instead of a call to mktime.
+     * Spans are learned from the C library the first time a time inside
+     * them is converted. */
+    class OffsetTable {
+    private:
+        struct Span {
+            std::time_t begin;  // first second with this offset
+            std::time_t end;    // first second after the span
+            long offset;        // seconds east of UTC
+        };
+        // Sorted by begin. Spans may overlap, they are all correct.
+        std::vector<Span> spans;
+        std::size_t last = 0;
+
+        // No zone changes its offset by more than this at once, so a local
+        // time this far from a transition is neither skipped nor repeated.
+        static const long MARGIN = 2 * 24 * 3600;
+        // How far to look for the borders of a span.
+        static const long SEARCHLIMIT = 400 * 24 * 3600;
+        // Offsets are probed at most this far apart. Larger steps could jump
+        // over a whole summer.
+        static const long MAXSTEP = 24 * 3600;
+
+        static long offsetAt(std::time_t t) {
+            std::tm tm;
+            localtime_r(&t, &tm);
+            return tm.tm_gmtoff;
+        }
+
+        static bool fits(const Span& span, long long local, std::time_t& out) {
+            long long t = local - span.offset;
+            if (t < (long long) span.begin + MARGIN ||
+                        t >= (long long) span.end - MARGIN)
+                return false;
+            out = (std::time_t) t;
+            return true;
+        }
+
+        /* Find the border of the span around t in the given direction. */
+        static std::time_t findBorder(std::time_t t, long offset, int dir) {
+            // Step outwards in growing steps, then bisect the last step.
+            long step = 3600;
+            std::time_t inside = t;
+            while ((inside - t) * dir < SEARCHLIMIT &&
+                        offsetAt(inside + dir * step) == offset) {
+                inside += dir * step;
+                step = std::min(step * 2, MAXSTEP);
+            }
+            if ((inside - t) * dir >= SEARCHLIMIT)
+                return dir > 0 ? inside + 1 : inside;
+            std::time_t outside = inside + dir * step;
+            while ((outside - inside) * dir > 1) {
+                std::time_t middle = inside + (outside - inside) / 2;
+                if (offsetAt(middle) == offset)
+                    inside = middle;
+                else
+                    outside = middle;
+            }
+            return dir > 0 ? outside : inside;
+        }
+
+    public:
+        /* Convert a local time, given as seconds since 01.01.1970 as if the
+         * local time was UTC. Returns false if the time is not cached. */
+        bool lookup(long long local, std::time_t& out) {
+            if (this->spans.empty())
+                return false;
+            if (fits(this->spans[this->last], local, out))
+                return true;
+            // The offset is at most a day, so this finds the right region.
+            Span key{(std::time_t) local, 0, 0};
+            auto it = std::upper_bound(this->spans.begin(), this->spans.end(),
+                key, [](const Span& a, const Span& b) {
+                    return a.begin < b.begin; });
+            std::size_t pos = it - this->spans.begin();
+            for (std::size_t i = pos > 2 ? pos - 2 : 0;
+                        i < pos + 1 && i < this->spans.size(); i++) {
+                if (fits(this->spans[i], local, out)) {
+                    this->last = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /* Get the offset at a time point and the span of time around it
+         * with the same offset, learning it if it is not cached. */
+        long offsetFor(std::time_t t, std::time_t& begin, std::time_t& end) {
+            bool found = !this->spans.empty() &&
+                this->spans[this->last].begin <= t &&
+                t < this->spans[this->last].end;
+            if (!found) {
+                Span key{t, 0, 0};
+                auto it = std::upper_bound(this->spans.begin(),
+                    this->spans.end(), key, [](const Span& a, const Span& b) {
+                        return a.begin < b.begin; });
+                std::size_t pos = it - this->spans.begin();
+                for (std::size_t i = pos; i > 0 && i + 2 > pos && !found;
+                            i--) {
+                    found = t < this->spans[i - 1].end;
+                    if (found)
+                        this->last = i - 1;
+                }
+            }
+            if (!found)
+                this->learn(t);
+            const Span& span = this->spans[this->last];
+            begin = span.begin;
+            end = span.end;
+            return span.offset;
+        }
+
+        /* Remember the span around a time point. */
+        void learn(std::time_t t) {
+            for (std::size_t i = 0; i < this->spans.size(); i++) {
+                if (this->spans[i].begin <= t && t < this->spans[i].end) {
+                    this->last = i;
+                    return;
+                }
+            }
+            long offset = offsetAt(t);
+            Span span{findBorder(t, offset, -1), findBorder(t, offset, 1),
+                      offset};
+            auto it = std::upper_bound(this->spans.begin(), this->spans.end(),
+                span, [](const Span& a, const Span& b) {
+                    return a.begin < b.begin; });
+            this->last = it - this->spans.begin();
+            this->spans.insert(it, span);
+        }
+    };
+
+    // Every thread learns its own spans, so parsing needs no locks.
+    thread_local OffsetTable offsetTable;
+
+    /* Read two digits. Returns a value above 99 if one is not a digit. */
+    inline unsigned twoDigits(const char *p) {
+        unsigned a = (unsigned char) p[0] - '0';
+        unsigned b = (unsigned char) p[1] - '0';
+        if (a > 9 || b > 9)
+            return 100;
+        return a * 10 + b;
+    }
+
+    /* Check the separators and digits of 'dd.mm.YYYY hh:mm:ss' without
+     * looking at the values. The string has to be DATESIZE bytes long. */
+    inline bool checkDateLayout(const char *p) {
+#ifdef __SSE2__
+        // Cover the 19 bytes with two overlapping loads of 16 bytes each.
+        // The pattern holds the separators and '0' for each digit.
+        const __m128i low = _mm_loadu_si128((const __m128i *) p);
+        const __m128i high = _mm_loadu_si128((const __m128i *) (p + 3));
+        const __m128i patternLow = _mm_setr_epi8(
+            '0','0','.','0','0','.','0','0','0','0',' ','0','0',':','0','0');
+        const __m128i patternHigh = _mm_setr_epi8(
+            '0','0','.','0','0','0','0',' ','0','0',':','0','0',':','0','0');
+        const __m128i digitsLow = _mm_setr_epi8(
+            -1,-1,0,-1,-1,0,-1,-1,-1,-1,0,-1,-1,0,-1,-1);
+        const __m128i digitsHigh = _mm_setr_epi8(
+            -1,-1,0,-1,-1,-1,-1,0,-1,-1,0,-1,-1,0,-1,-1);
+        // Digits are checked by c - '0' being at most 9 when saturated, the
+        // separators by being equal to the pattern.
+        __m128i diffLow = _mm_subs_epu8(low, patternLow);
+        __m128i diffHigh = _mm_subs_epu8(high, patternHigh);
+        __m128i nine = _mm_set1_epi8(9);
+        __m128i okLow = _mm_or_si128(
+            _mm_and_si128(digitsLow, _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_max_epu8(diffLow, nine), nine),
+                _mm_cmpeq_epi8(_mm_max_epu8(low, patternLow), low))),
+            _mm_andnot_si128(digitsLow, _mm_cmpeq_epi8(low, patternLow)));
+        __m128i okHigh = _mm_or_si128(
+            _mm_and_si128(digitsHigh, _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_max_epu8(diffHigh, nine), nine),
+                _mm_cmpeq_epi8(_mm_max_epu8(high, patternHigh), high))),
+            _mm_andnot_si128(digitsHigh, _mm_cmpeq_epi8(high, patternHigh)));
+        return (_mm_movemask_epi8(_mm_and_si128(okLow, okHigh)) & 0xFFFF)
+                                                                  == 0xFFFF;
+#else
+        for (int i = 0; i < DATESIZE; i++) {
+            char c = p[i];
+            bool digit = (unsigned char) (c - '0') <= 9;
+            if (i == 2 || i == 5) {
+                if (c != '.') return false;
+            } else if (i == 10) {
+                if (c != ' ') return false;
+            } else if (i == 13 || i == 16) {
+                if (c != ':') return false;
+            } else if (!digit) {
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    /* Convert a string of the layout 'dd.mm.YYYY hh:mm:ss' without checking
+     * the layout. Returns false for values the fast path does not handle,
+     * the caller has to fall back to parseDateStrSlow then. */
+    inline bool convertDate(const char *p, time_point& out) {
+        unsigned day = twoDigits(p);
+        unsigned month = twoDigits(p + 3);
+        unsigned year = twoDigits(p + 6) * 100 + twoDigits(p + 8);
+        unsigned hour = twoDigits(p + 11);
+        unsigned minute = twoDigits(p + 14);
+        unsigned second = twoDigits(p + 17);
+        // Leap seconds and years before 1900 are left to the C library.
+        if (day < 1 || day > 31 || month < 1 || month > 12 || year < 1900 ||
+                    year > 9999 || hour > 23 || minute > 59 || second > 59)
+            return false;
+        long long local = daysFromCivil(year, month, day) * 86400
+                            + hour * 3600 + minute * 60 + second;
+        std::time_t time_t;
+        if (!offsetTable.lookup(local, time_t))
+            return false;
+        out = clock::from_time_t(time_t);
+        return true;
+    }
+
+    /* Get a time point from a string. */
+    time_point parseDateStr(std::string_view s) {
+        time_point res;
+        if (s.size() == (std::size_t) DATESIZE && checkDateLayout(s.data())
+                    && convertDate(s.data(), res)) {
+            return res;
+        }
+        res = parseDateStrSlow(s);
+        // Cache the offset around this time for the next calls.
+        if (s.size() == (std::size_t) DATESIZE)
+            offsetTable.learn(clock::to_time_t(res));
+        return res;
+    }
+
+    /* Get time points from many strings at once. Each string has to hold at
+     * least DATESIZE bytes, only those are parsed. Returns the number of
+     * strings converted before the first one that does not match the
+     * format. */
+    std::size_t parseDateStrs(const char *const *strs, std::size_t count,
+                              time_point *out) {
+        for (std::size_t i = 0; i < count; i++) {
+            if (checkDateLayout(strs[i]) && convertDate(strs[i], out[i]))
+                continue;
+            try {
+                out[i] = parseDateStr(std::string_view(strs[i], DATESIZE));
+            } catch (DateFormatException& ex) {
+                return i;
+            }
+        }
+        return count;
+    }
+
     /* Get a duration from a string. */
     duration parseDurationStr(const std::string& str) {
         try {
@@ -111,90 +403,306 @@ namespace DateTime {
         return chrono::system_clock::to_time_t(time);
     }
 
+    // Longest output of the format functions below
+    const int FORMATSIZE = 48;
+
+    const char DIGITPAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233"
+        "34353637383940414243444546474849505152535455565758596061626364656667"
+        "6869707172737475767778798081828384858687888990919293949596979899";
+
+    /* Write a number of two digits. */
+    inline char *putTwoDigits(char *out, unsigned value) {
+        memcpy(out, DIGITPAIRS + 2 * value, 2);
+        return out + 2;
+    }
+
+    /* Write a number without leading zeros. */
+    inline char *putNumber(char *out, unsigned long long value) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = '0' + value % 10;
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            *out++ = digits[--count];
+        }
+        return out;
+    }
+
+    /* Write 'dd.mm.YYYY' of a broken down time. Years that do not have four
+     * digits are left to strftime. */
+    inline char *putDate(char *out, const std::tm& tm) {
+        int year = tm.tm_year + 1900;
+        if (year < 0 || year > 9999) {
+            char buff[32];
+            std::size_t size = std::strftime(buff, 32, "%d.%m.%Y", &tm);
+            memcpy(out, buff, size);
+            return out + size;
+        }
+        out = putTwoDigits(out, tm.tm_mday);
+        *out++ = '.';
+        out = putTwoDigits(out, tm.tm_mon + 1);
+        *out++ = '.';
+        out = putTwoDigits(out, year / 100);
+        return putTwoDigits(out, year % 100);
+    }
+
+    /* Write 'hh:mm:ss'. */
+    inline char *putClock(char *out, unsigned hour, unsigned minute,
+                          unsigned second) {
+        out = putTwoDigits(out, hour);
+        *out++ = ':';
+        out = putTwoDigits(out, minute);
+        *out++ = ':';
+        return putTwoDigits(out, second);
+    }
+
+    /* Caches the local date of one day, so that the time points of that day
+     * are broken down and formatted by integer arithmetic. Consecutive
+     * entries mostly share a day. Other days are converted with the offsets
+     * the OffsetTable knows, only days on which the offset changes are not
+     * cached. */
+    class DayCache {
+    private:
+        // The day as seconds since 01.01.1970 in UTC, end excluded
+        std::time_t begin = 0;
+        std::time_t end = 0;
+        // The day broken down at its beginning
+        std::tm day{};
+        // 'dd.mm.YYYY ' and 'Mon dd.mm.YYYY', if the year has four digits
+        char date[11];
+        char weekday[14];
+        bool prefixes = false;
+
+        /* Break down a time point of another day and cache its day. */
+        void fill(std::time_t t, std::tm& out) {
+            std::time_t spanBegin, spanEnd;
+            long offset = offsetTable.offsetFor(t, spanBegin, spanEnd);
+            long long local = (long long) t + offset;
+            long long days = local >= 0 ? local / 86400
+                                        : -((-local + 86399) / 86400);
+            unsigned second = (unsigned) (local - days * 86400);
+            long long y;
+            unsigned m, d;
+            civilFromDays(days, y, m, d);
+            out = std::tm{};
+            out.tm_year = (int) (y - 1900);
+            out.tm_mon = m - 1;
+            out.tm_mday = d;
+            out.tm_wday = (int) (((days + 4) % 7 + 7) % 7);
+            out.tm_yday = (int) (days - daysFromCivil(y, 1, 1));
+            out.tm_isdst = -1;
+            out.tm_gmtoff = offset;
+            std::time_t first = t - second;
+            if (first < spanBegin || first + 86400 > spanEnd) {
+                // The offset changes on this day, the C library knows how.
+                localtime_r(&t, &out);
+                return;
+            }
+            this->begin = first;
+            this->end = first + 86400;
+            this->day = out;
+            out.tm_hour = second / 3600;
+            out.tm_min = second / 60 % 60;
+            out.tm_sec = second % 60;
+            this->prefixes = y >= 0 && y <= 9999;
+            if (this->prefixes) {
+                static const char WEEKDAYS[] = "SunMonTueWedThuFriSat";
+                putDate(this->date, this->day);
+                this->date[10] = ' ';
+                memcpy(this->weekday, WEEKDAYS + 3 * out.tm_wday, 3);
+                this->weekday[3] = ' ';
+                memcpy(this->weekday + 4, this->date, 10);
+            }
+        }
+
+    public:
+        /* Break down a time point like localtime_r does, except that
+         * tm_isdst is not known outside of the days the offset changes
+         * on. */
+        void breakDown(std::time_t t, std::tm& out) {
+            if (t >= this->begin && t < this->end) {
+                unsigned second = (unsigned) (t - this->begin);
+                out = this->day;
+                out.tm_hour = second / 3600;
+                out.tm_min = second / 60 % 60;
+                out.tm_sec = second % 60;
+                return;
+            }
+            this->fill(t, out);
+        }
+
+        /* Write 'dd.mm.YYYY hh:mm:ss'. */
+        char *formatDate(char *out, std::time_t t) {
+            std::tm tm;
+            this->breakDown(t, tm);
+            if (t >= this->begin && t < this->end && this->prefixes) {
+                memcpy(out, this->date, 11);
+                out += 11;
+            }
+            else {
+                out = putDate(out, tm);
+                *out++ = ' ';
+            }
+            return putClock(out, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        }
+
+        /* Write 'Mon dd.mm.YYYY'. */
+        char *formatDay(char *out, std::time_t t) {
+            static const char WEEKDAYS[] = "SunMonTueWedThuFriSat";
+            std::tm tm;
+            this->breakDown(t, tm);
+            if (t >= this->begin && t < this->end && this->prefixes) {
+                memcpy(out, this->weekday, 14);
+                return out + 14;
+            }
+            memcpy(out, WEEKDAYS + 3 * tm.tm_wday, 3);
+            out[3] = ' ';
+            return putDate(out + 4, tm);
+        }
+    };
+
+    thread_local DayCache dayCache;
+
     /* Tranlate to a tm object. */
-    std::tm *to_tm(const time_point& time) {
-        std::time_t time_t = to_time_t(time);
-        return localtime(&time_t);
+    std::tm to_tm(const time_point& time) {
+        std::tm tm;
+        dayCache.breakDown(to_time_t(time), tm);
+        return tm;
+    }
+
+    /* Write a date as 'dd.mm.YYYY hh:mm:ss' without a null termination.
+     * Returns the end of what was written. */
+    char *formatDate(char *out, const time_point& time) {
+        return dayCache.formatDate(out, to_time_t(time));
+    }
+
+    /* Write a date as 'Mon 01.01.1970'. */
+    char *formatDay(char *out, const time_point& time) {
+        return dayCache.formatDay(out, to_time_t(time));
+    }
+
+    /* Write a duration in hours and minutes, like '2h15min'. */
+    char *formatDuration(char *out, duration time) {
+        long long h = chrono::duration_cast<hours>(time).count();
+        time %= hours(1);
+        long long m = chrono::duration_cast<minutes>(time).count();
+        char *begin = out;
+        if (h > 0) {
+            out = putNumber(out, h);
+            *out++ = 'h';
+        }
+        if (m > 0) {
+            out = putNumber(out, m);
+            memcpy(out, "min", 3);
+            out += 3;
+        }
+        // ensure that nothing empty is written
+        if (out == begin) {
+            *out++ = '0';
+        }
+        return out;
     }
 
     /* Convert a date to a string. */
     std::string toString(const time_point& time) {
-        // one byte more for null termination
-        char buff[DATESIZE + 1];
-        std::tm *tm = to_tm(time);
-        std::strftime(buff, DATESIZE + 1, DATEFORMAT, tm);
-        return std::string(buff);
+        char buff[FORMATSIZE];
+        return std::string(buff, formatDate(buff, time) - buff);
     }
 
     /* Convert a date to a string skipping the clock time. */
     std::string toDateString(const time_point& time) {
         // e.g. 'Mon 01.01.1970'
-        char buff[16];
-        std::tm *tm = to_tm(time);
-        std::strftime(buff, 16, "%a %d.%m.%Y", tm);
-        return std::string(buff);
+        char buff[FORMATSIZE];
+        return std::string(buff, formatDay(buff, time) - buff);
     }
 
     /* Convert a date to a string using only the clock time. */
     std::string toClockTimeStr(const time_point& time) {
         // e.g. '17:21:02'
-        char buff[9];
-        std::tm *tm = to_tm(time);
-        std::strftime(buff, 9, "%H:%M:%S", tm);
-        return std::string(buff);
+        char buff[8];
+        std::tm tm = to_tm(time);
+        putClock(buff, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        return std::string(buff, 8);
     }
 
     /* Convert a duration to a string. */
     std::string toString(duration time) {
-        int h = chrono::duration_cast<hours>(time).count();
-        time %= hours(1);
-        int m = chrono::duration_cast<minutes>(time).count();
-        std::stringstream ss;
-        if (h>0) {
-            ss << h << "h";
-        }
-        if (m>0) {
-            ss << m << "min";
-        }
-        // ensure that no empty string is returned
-        if (ss.str().empty()) {
-            ss << "0";
-        }
-        return ss.str();
+        char buff[FORMATSIZE];
+        return std::string(buff, formatDuration(buff, time) - buff);
     }
 
     /* Get the time 0:00 of the given day. */
     time_point getBeginOfDay(const time_point& time) {
-        std::tm *tm = to_tm(time);
+        std::tm tm = to_tm(time);
         time_point res = time;
-        res -= hours( tm->tm_hour );
-        res -= minutes( tm->tm_min );
-        res -= seconds( tm->tm_sec );
+        res -= hours( tm.tm_hour );
+        res -= minutes( tm.tm_min );
+        res -= seconds( tm.tm_sec );
         return res;
     }
 
     /* Get the first day of the week of the given day. */
     time_point getLastMonday(const time_point& time) {
-        std::tm *tm = to_tm(time);
+        std::tm tm = to_tm(time);
         time_point res = time;
-        res -= days( (tm->tm_wday - 1) % 7 );
+        res -= days( (tm.tm_wday - 1) % 7 );
         return res;
     }
 
     /* Get the first day of the month of the given day. */
     time_point getLastFirstOfMonth(const time_point& time) {
-        std::tm *tm = to_tm(time);
+        std::tm tm = to_tm(time);
         time_point res = time;
-        res -= days( tm->tm_mday - 1 );
+        res -= days( tm.tm_mday - 1 );
         return res;
     }
 
     /* Get the first day of the year of the given day. */
     time_point getLastFirstOfYear(const time_point& time) {
-        std::tm *tm = to_tm(time);
+        std::tm tm = to_tm(time);
         time_point res = time;
-        res -= days( tm->tm_yday - 1 );
+        res -= days( tm.tm_yday - 1 );
         return res;
     };
+
+    /* Number of the local day of a time point, counted from 01.01.1970. */
+    long long toDayNumber(const time_point& time) {
+        std::tm tm = to_tm(time);
+        return daysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    }
+
+    /* Number of the day of a string starting with 'dd.mm.YYYY', counted
+     * from 01.01.1970. Returns false if the string does not start so. */
+    bool parseDayNumber(const char *p, long long& out) {
+        unsigned day = twoDigits(p);
+        unsigned month = twoDigits(p + 3);
+        unsigned year = twoDigits(p + 6) * 100 + twoDigits(p + 8);
+        if (p[2] != '.' || p[5] != '.' || day < 1 || day > 31 ||
+                    month < 1 || month > 12 || year > 9999)
+            return false;
+        out = daysFromCivil(year, month, day);
+        return true;
+    }
+
+    /* The time 0:00 of a day counted from 01.01.1970. */
+    time_point beginOfDayNumber(long long day) {
+        std::time_t time_t;
+        if (offsetTable.lookup(day * 86400, time_t))
+            return clock::from_time_t(time_t);
+        long long y;
+        unsigned m, d;
+        civilFromDays(day, y, m, d);
+        std::tm tm{};
+        tm.tm_year = (int) y - 1900;
+        tm.tm_mon = m - 1;
+        tm.tm_mday = d;
+        tm.tm_isdst = -1;
+        time_t = std::mktime(&tm);
+        offsetTable.learn(time_t);
+        return clock::from_time_t(time_t);
+    }
     
 }
@@ -0,0 +1,394 @@
+/* File methods
+ */
+
+MappedFile::MappedFile() {
+    this->data = nullptr;
+    this->size = 0;
+}
+
+/* Map the whole file. An empty file is not mapped at all. */
+void MappedFile::map(int fd) {
+    this->unmap();
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        throw CorruptedFileException("Could not read the file size");
+    }
+    if (info.st_size == 0) {
+        return;
+    }
+    void *res = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (res == MAP_FAILED) {
+        throw CorruptedFileException("Could not map the file");
+    }
+    this->data = (const char *) res;
+    this->size = info.st_size;
+}
+
+void MappedFile::unmap() {
+    if (this->data) {
+        munmap((void *) this->data, this->size);
+    }
+    this->data = nullptr;
+    this->size = 0;
+}
+
+const char *MappedFile::getData() {
+    return this->data;
+}
+
+size_t MappedFile::getSize() {
+    return this->size;
+}
+
+MappedFile::~MappedFile() {
+    this->unmap();
+}
+
+/* Write the whole string at the given offset, or append it if the offset is
+ * negative. */
+void writeAll(int fd, const string& str, off_t offset) {
+    const char *pos = str.data();
+    size_t left = str.size();
+    Profiler::bytesWritten += left;
+    if (offset < 0 && lseek(fd, 0, SEEK_END) < 0) {
+        throw CorruptedFileException("Could not write the log file");
+    }
+    while (left > 0) {
+        ssize_t res = offset < 0 ? write(fd, pos, left)
+                                 : pwrite(fd, pos, left, offset);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            throw CorruptedFileException("Could not write the log file");
+        }
+        pos += res;
+        left -= res;
+        if (offset >= 0)
+            offset += res;
+    }
+}
+
+/* Read everything up to the end of the file. Returns false on an error. */
+bool readAll(int fd, string& out) {
+    const size_t CHUNK = 1 << 16;
+    while (true) {
+        size_t size = out.size();
+        out.resize(size + CHUNK);
+        ssize_t res = read(fd, &out[size], CHUNK);
+        if (res < 0 && errno == EINTR) {
+            out.resize(size);
+            continue;
+        }
+        out.resize(size + std::max(res, (ssize_t) 0));
+        Profiler::bytesRead += std::max(res, (ssize_t) 0);
+        if (res <= 0)
+            return res == 0;
+    }
+}
+
+/* Create or replace a file with the given content. The content is synced to
+ * the disk before this returns, so the file can be renamed safely. */
+void writeFile(const string& filename, const string& content) {
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw CorruptedFileException("Could not create "+filename);
+    }
+    try {
+        writeAll(fd, content, 0);
+    } catch (CorruptedFileException& ex) {
+        close(fd);
+        throw;
+    }
+    fsync(fd);
+    close(fd);
+}
+
+// A journal starts with this, followed by the offset, the sizes of the file
+// name and the text, the file name, the text and a checksum of both.
+const char JOURNALMAGIC[8] = {'J','L','J','R','N','L','0','1'};
+const size_t JOURNALHEADERSIZE = 32;
+
+/* FNV-1a hash, to tell whether a journal was written completely. */
+uint64_t checksum(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i=0; i<size; i++) {
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* A hash of eight bytes at a time, to tell whether the logs were changed
+ * since they were checked. A hash of several pieces starts each with the
+ * hash of the ones before. */
+uint64_t fastChecksum(const char *data, size_t size, uint64_t hash) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+/* Put the text at the given offset and cut the file behind it. Files that
+ * are opened for appending are switched to positioned writes meanwhile. */
+void writeTail(int fd, const string& text, off_t offset) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && (flags & O_APPEND))
+        fcntl(fd, F_SETFL, flags & ~O_APPEND);
+    try {
+        writeAll(fd, text, offset);
+        if (ftruncate(fd, offset + text.size()) != 0) {
+            throw CorruptedFileException("Could not write the log file");
+        }
+    } catch (CorruptedFileException& ex) {
+        if (flags >= 0)
+            fcntl(fd, F_SETFL, flags);
+        throw;
+    }
+    if (flags >= 0)
+        fcntl(fd, F_SETFL, flags);
+    fsync(fd);
+}
+
+/* Replace everything of a file in the given directory from the given offset
+ * on by the given text. The change is written to the file 'journal' first,
+ * so that recoverJournal can complete it if the process dies in between. */
+void overwriteTail(const string& path, const string& name, int fd,
+                   const string& text, off_t offset) {
+    uint64_t header[3] = {(uint64_t) offset, name.size(), text.size()};
+    string journal(JOURNALMAGIC, 8);
+    journal.append((const char *) header, sizeof(header));
+    journal += name;
+    journal += text;
+    uint64_t sum = checksum(journal.data() + JOURNALHEADERSIZE,
+                            journal.size() - JOURNALHEADERSIZE);
+    journal.append((const char *) &sum, 8);
+    writeFile(path + "/journal", journal);
+    writeTail(fd, text, offset);
+    unlink((path + "/journal").c_str());
+}
+
+/* Complete a change of overwriteTail that was interrupted. A journal that
+ * was not written completely is dropped, the file was not touched yet
+ * then. */
+void recoverJournal(const string& path) {
+    string filename = path + "/journal";
+    std::ifstream file(filename, std::ios::binary);
+    if (! file)
+        return;
+    string journal((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+    file.close();
+    uint64_t header[3];
+    uint64_t sum;
+    bool valid = journal.size() >= JOURNALHEADERSIZE + 8 &&
+                 memcmp(journal.data(), JOURNALMAGIC, 8) == 0;
+    if (valid) {
+        memcpy(header, journal.data() + 8, sizeof(header));
+        valid = header[1] <= journal.size() && header[2] <= journal.size() &&
+                journal.size() == JOURNALHEADERSIZE + header[1] + header[2] + 8;
+    }
+    if (valid) {
+        memcpy(&sum, journal.data() + journal.size() - 8, 8);
+        valid = sum == checksum(journal.data() + JOURNALHEADERSIZE,
+                                journal.size() - JOURNALHEADERSIZE - 8);
+    }
+    if (valid) {
+        string name = journal.substr(JOURNALHEADERSIZE, header[1]);
+        string text = journal.substr(JOURNALHEADERSIZE + header[1],
+                                     header[2]);
+        int fd = open((path + "/" + name).c_str(), O_RDWR);
+        if (fd < 0)
+            throw CorruptedFileException("Could not complete the journal");
+        try {
+            writeTail(fd, text, header[0]);
+        } catch (CorruptedFileException& ex) {
+            close(fd);
+            throw;
+        }
+        close(fd);
+    }
+    unlink(filename.c_str());
+}
+
+
+bool FileStamp::operator==(const FileStamp& other) const {
+    return this->inode == other.inode && this->size == other.size &&
+           this->modified.tv_sec == other.modified.tv_sec &&
+           this->modified.tv_nsec == other.modified.tv_nsec;
+}
+
+/* Get the stamp of a file. A missing file gets an empty stamp. */
+FileStamp stampFile(const string& filename) {
+    FileStamp res{0, -1, {0, 0}};
+    struct stat info;
+    if (stat(filename.c_str(), &info) == 0) {
+        res.inode = info.st_ino;
+        res.size = info.st_size;
+        res.modified = info.st_mtim;
+    }
+    return res;
+}
+
+/* A hash of the given stamps, to tell later whether the files are still the
+ * same without keeping all of them. */
+uint64_t digestStamps(const vector<FileStamp>& stamps) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const FileStamp& stamp : stamps) {
+        int64_t fields[4] = {(int64_t) stamp.inode, (int64_t) stamp.size,
+                             (int64_t) stamp.modified.tv_sec,
+                             (int64_t) stamp.modified.tv_nsec};
+        hash = fastChecksum((const char *) fields, sizeof(fields), hash);
+    }
+    return hash;
+}
+
+/* Collect the directories of logs below the given one. Hidden directories
+ * and symbolic links are not followed, so every project is found once. */
+void findLogDirs(const string& dir, vector<string>& out) {
+    string logs = dir + "/" + SAVEPATH;
+    if (LogList::existsIn(logs))
+        out.push_back(logs);
+    DIR *handle = opendir(dir.c_str());
+    if (handle == nullptr)
+        return;
+    vector<string> children;
+    struct dirent *child;
+    while ((child = readdir(handle)) != nullptr) {
+        if (child->d_name[0] == '.')
+            continue;
+        string path = dir + "/" + child->d_name;
+        if (child->d_type == DT_UNKNOWN) {
+            struct stat info;
+            if (lstat(path.c_str(), &info) != 0 || ! S_ISDIR(info.st_mode))
+                continue;
+        }
+        else if (child->d_type != DT_DIR) {
+            continue;
+        }
+        children.push_back(path);
+    }
+    closedir(handle);
+    for (const string& path : children)
+        findLogDirs(path, out);
+}
+
+
+FileLock::FileLock() {
+    this->fd = -1;
+    this->exclusive = false;
+}
+
+FileLock::~FileLock() {
+    this->release();
+}
+
+/* Wait for the lock of the logs in the given directory. Readers share it,
+ * writers hold it alone. If there is no way to create the lock file, like
+ * on a read only medium, nothing is locked. */
+void FileLock::acquire(const string& path, bool exclusive) {
+    ProfileScope scope(Phase::lock);
+    this->release();
+    string filename = path + "/lock";
+    this->fd = open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (this->fd < 0)
+        this->fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (this->fd < 0)
+        return;
+    while (flock(this->fd, exclusive ? LOCK_EX : LOCK_SH) != 0) {
+        if (errno != EINTR) {
+            this->release();
+            throw CorruptedFileException("Could not lock the logs");
+        }
+    }
+    this->exclusive = exclusive;
+}
+
+void FileLock::release() {
+    if (this->fd >= 0)
+        close(this->fd);
+    this->fd = -1;
+    this->exclusive = false;
+}
+
+/* Tell whether nobody else holds the lock. */
+bool FileLock::isExclusive() {
+    return this->exclusive;
+}
+
+
+// Size of the buffer of an OutputBuffer
+const size_t OUTPUTBUFFERSIZE = 1 << 18;
+
+OutputBuffer::OutputBuffer(int fd) {
+    this->fd = fd;
+    this->data = new char[OUTPUTBUFFERSIZE];
+    this->used = 0;
+}
+
+OutputBuffer::~OutputBuffer() {
+    this->flush();
+    delete[] this->data;
+}
+
+/* Write out what was collected. If this fails, the output is dropped, like
+ * a stream would do. */
+void OutputBuffer::flush() {
+    ProfileScope scope(Phase::output);
+    const char *pos = this->data;
+    size_t left = this->used;
+    while (left > 0) {
+        ssize_t res = write(this->fd, pos, left);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        pos += res;
+        left -= res;
+    }
+    this->used = 0;
+}
+
+void OutputBuffer::put(std::string_view text) {
+    if (this->used + text.size() > OUTPUTBUFFERSIZE) {
+        this->flush();
+        // Text that does not fit at all is written in pieces.
+        while (text.size() > OUTPUTBUFFERSIZE) {
+            memcpy(this->data, text.data(), OUTPUTBUFFERSIZE);
+            this->used = OUTPUTBUFFERSIZE;
+            this->flush();
+            text.remove_prefix(OUTPUTBUFFERSIZE);
+        }
+    }
+    memcpy(this->data + this->used, text.data(), text.size());
+    this->used += text.size();
+}
+
+void OutputBuffer::put(char c) {
+    if (this->used == OUTPUTBUFFERSIZE)
+        this->flush();
+    this->data[this->used++] = c;
+}
+
+/* Write a date like 'Mon 01.01.1970'. */
+void OutputBuffer::putDay(const dt::time_point& time) {
+    if (this->used + dt::FORMATSIZE > OUTPUTBUFFERSIZE)
+        this->flush();
+    this->used = dt::formatDay(this->data + this->used, time) - this->data;
+}
+
+/* Write a duration like '2h15min'. */
+void OutputBuffer::putDuration(const dt::duration& time) {
+    if (this->used + dt::FORMATSIZE > OUTPUTBUFFERSIZE)
+        this->flush();
+    this->used = dt::formatDuration(this->data + this->used, time)
+                                                               - this->data;
+}
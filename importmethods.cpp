@@ -0,0 +1,457 @@
+/* Import methods
+ *
+ * Entries from other trackers are read from CSV or JSON lines, sorted and
+ * merged with the logs in one pass. The merged logs are written to new
+ * files, which replace the old ones at once: for the text format by
+ * replacing the manifest, for the binary format by renaming 'logs.bin'.
+ */
+
+/* Convert a time as 'dd.mm.yyyy hh:mm:ss' or 'yyyy-mm-dd hh:mm:ss', with
+ * either a space or a 'T' in between. */
+dt::time_point parseImportTime(std::string_view str) {
+    if (str.size() == (size_t) dt::DATESIZE && str[4] == '-' &&
+                str[7] == '-' && (str[10] == 'T' || str[10] == ' ')) {
+        string date = string(str.substr(8, 2)) + "." +
+                      string(str.substr(5, 2)) + "." +
+                      string(str.substr(0, 4)) + " " +
+                      string(str.substr(11));
+        return dt::parseDateStr(date);
+    }
+    return dt::parseDateStr(str);
+}
+
+/* Turn the fields of one imported entry into a LogEntry. The note is kept
+ * in the given pool. */
+LogEntry makeImportEntry(StringPool& notes, std::string_view time,
+                         std::string_view type, string note) {
+    dt::time_point point;
+    try {
+        point = parseImportTime(time);
+    } catch (dt::DateFormatException& ex) {
+        throw SituationalMistake("Invalid time '"+string(time)+"'");
+    }
+    if (type == "start" || type == "end") {
+        LogEntryType kind = type == "start" ? LogEntryType::start :
+                                              LogEntryType::end;
+        return LogEntry(kind, point, std::string_view());
+    }
+    if (type != "log")
+        throw SituationalMistake("Unknown type '"+string(type)+"'");
+    // A note takes a single line in the text format.
+    std::replace(note.begin(), note.end(), '\n', ' ');
+    std::replace(note.begin(), note.end(), '\r', ' ');
+    if (note.empty())
+        throw SituationalMistake("Empty log");
+    size_t offset = notes.add(note);
+    return LogEntry(LogEntryType::log, point, notes.get(offset, note.size()));
+}
+
+/* Read entries as CSV with the columns time, type and note. Fields may be
+ * quoted, a first line 'time,type,note' is skipped. */
+void parseImportCsv(const string& input, StringPool& notes,
+                    vector<LogEntry>& out) {
+    size_t pos = 0;
+    size_t line = 1;
+    while (pos < input.size()) {
+        size_t recordLine = line;
+        vector<string> fields(1);
+        bool quoted = false;
+        for (; pos < input.size(); pos++) {
+            char c = input[pos];
+            if (quoted) {
+                if (c != '"') {
+                    line += c == '\n';
+                    fields.back() += c;
+                }
+                else if (pos + 1 < input.size() && input[pos+1] == '"') {
+                    fields.back() += '"';
+                    pos++;
+                }
+                else {
+                    quoted = false;
+                }
+            }
+            else if (c == '"') {
+                quoted = true;
+            }
+            else if (c == ',') {
+                fields.emplace_back();
+            }
+            else if (c == '\n') {
+                break;
+            }
+            else if (c != '\r') {
+                fields.back() += c;
+            }
+        }
+        pos++;
+        line++;
+        if (fields.size() == 1 && fields[0].empty())
+            continue;
+        if (recordLine == 1 && fields[0] == "time")
+            continue;
+        try {
+            if (quoted)
+                throw SituationalMistake("Unterminated quote");
+            if (fields.size() < 2 || fields.size() > 3)
+                throw SituationalMistake("Expected time, type and note");
+            out.push_back(makeImportEntry(notes, fields[0], fields[1],
+                    fields.size() > 2 ? fields[2] : string()));
+        } catch (SituationalMistake& ex) {
+            throw SituationalMistake("Line "+std::to_string(recordLine)+": "
+                                     +ex.what());
+        }
+    }
+}
+
+/* Append a code point as UTF-8. */
+void appendUtf8(string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += (char) code;
+    }
+    else if (code < 0x800) {
+        out += (char) (0xC0 | (code >> 6));
+        out += (char) (0x80 | (code & 0x3F));
+    }
+    else if (code < 0x10000) {
+        out += (char) (0xE0 | (code >> 12));
+        out += (char) (0x80 | ((code >> 6) & 0x3F));
+        out += (char) (0x80 | (code & 0x3F));
+    }
+    else {
+        out += (char) (0xF0 | (code >> 18));
+        out += (char) (0x80 | ((code >> 12) & 0x3F));
+        out += (char) (0x80 | ((code >> 6) & 0x3F));
+        out += (char) (0x80 | (code & 0x3F));
+    }
+}
+
+/* Read the four hex digits of a \u escape. */
+uint32_t parseHex4(std::string_view str, size_t pos) {
+    if (pos + 4 > str.size())
+        throw SituationalMistake("Broken escape");
+    uint32_t res = 0;
+    for (size_t i=pos; i<pos+4; i++) {
+        char c = str[i];
+        res <<= 4;
+        if (c >= '0' && c <= '9') res |= c - '0';
+        else if (c >= 'a' && c <= 'f') res |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') res |= c - 'A' + 10;
+        else throw SituationalMistake("Broken escape");
+    }
+    return res;
+}
+
+/* Read a JSON string starting at the quote at the given position. The
+ * position is moved behind the closing quote. */
+string parseJsonString(std::string_view str, size_t& pos) {
+    string res;
+    pos++;
+    while (true) {
+        if (pos >= str.size())
+            throw SituationalMistake("Unterminated string");
+        char c = str[pos++];
+        if (c == '"')
+            return res;
+        if (c != '\\') {
+            res += c;
+            continue;
+        }
+        if (pos >= str.size())
+            throw SituationalMistake("Unterminated string");
+        c = str[pos++];
+        switch (c) {
+            case '"': case '\\': case '/': res += c; break;
+            case 'b': res += '\b'; break;
+            case 'f': res += '\f'; break;
+            case 'n': res += '\n'; break;
+            case 'r': res += '\r'; break;
+            case 't': res += '\t'; break;
+            case 'u': {
+                uint32_t code = parseHex4(str, pos);
+                pos += 4;
+                if (code >= 0xD800 && code < 0xDC00 && pos + 6 <= str.size()
+                            && str[pos] == '\\' && str[pos+1] == 'u') {
+                    uint32_t low = parseHex4(str, pos + 2);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        code = 0x10000 + ((code - 0xD800) << 10) +
+                               (low - 0xDC00);
+                        pos += 6;
+                    }
+                }
+                appendUtf8(res, code);
+                break;
+            }
+            default:
+                throw SituationalMistake("Broken escape");
+        }
+    }
+}
+
+/* Read entries as JSON lines. Each line is an object with the strings
+ * "time", "type" and, for logs, "note". Other members are ignored. */
+void parseImportJsonl(const string& input, StringPool& notes,
+                      vector<LogEntry>& out) {
+    size_t pos = 0;
+    size_t lineNumber = 0;
+    while (pos < input.size()) {
+        size_t lineEnd = input.find('\n', pos);
+        if (lineEnd == string::npos)
+            lineEnd = input.size();
+        std::string_view line(input.data() + pos, lineEnd - pos);
+        pos = lineEnd + 1;
+        lineNumber++;
+        size_t i = 0;
+        auto skipSpace = [&]() {
+            while (i < line.size() && (line[i] == ' ' || line[i] == '\t' ||
+                                       line[i] == '\r'))
+                i++;
+        };
+        auto expect = [&](char c) {
+            skipSpace();
+            if (i >= line.size() || line[i] != c)
+                throw SituationalMistake(string("Expected '")+c+"'");
+            i++;
+        };
+        try {
+            skipSpace();
+            if (i == line.size())
+                continue;
+            string time;
+            string type;
+            string note;
+            expect('{');
+            skipSpace();
+            bool first = true;
+            while (i < line.size() && line[i] != '}') {
+                if (! first)
+                    expect(',');
+                first = false;
+                skipSpace();
+                if (i >= line.size() || line[i] != '"')
+                    throw SituationalMistake("Expected a member name");
+                string key = parseJsonString(line, i);
+                expect(':');
+                skipSpace();
+                if (i < line.size() && line[i] == '"') {
+                    string value = parseJsonString(line, i);
+                    if (key == "time") time = value;
+                    else if (key == "type") type = value;
+                    else if (key == "note") note = value;
+                }
+                else {
+                    // Numbers, true, false and null are skipped.
+                    while (i < line.size() && line[i] != ',' &&
+                                line[i] != '}')
+                        i++;
+                }
+                skipSpace();
+            }
+            expect('}');
+            skipSpace();
+            if (i != line.size())
+                throw SituationalMistake("Unexpected text behind the object");
+            out.push_back(makeImportEntry(notes, time, type, note));
+        } catch (SituationalMistake& ex) {
+            throw SituationalMistake("Line "+std::to_string(lineNumber)+": "
+                                     +ex.what());
+        }
+    }
+}
+
+/* Follows the sessions along the merged logs and complains about entries
+ * that do not fit in. */
+void checkImportStep(bool& active, LogEntry& entry, bool imported) {
+    LogEntryType type = entry.type();
+    if (type == LogEntryType::start) {
+        if (active)
+            throw SituationalMistake("Two starts without end at "
+                                     +dt::toString(entry.getTime()));
+        active = true;
+    }
+    else if (type == LogEntryType::end) {
+        if (! active)
+            throw SituationalMistake("End without start at "
+                                     +dt::toString(entry.getTime()));
+        active = false;
+    }
+    else if (imported && ! active) {
+        throw SituationalMistake("Log outside of a session at "
+                                 +dt::toString(entry.getTime()));
+    }
+}
+
+/* Merge the given entries into the logs. Entries at the same time as
+ * existing ones go behind them. The LogList has to be loaded again
+ * afterwards. */
+void LogList::import(vector<LogEntry>& entries) {
+    if (entries.empty())
+        return;
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](LogEntry a, LogEntry b) {
+        return a.getTime() < b.getTime();
+    });
+    // The merge works on the files, so they have to hold everything.
+    if (this->needsToBeWritten > 0 || this->amended < this->entries.size())
+        throw SituationalMistake("Save the logs before importing");
+    if (this->format == LogFormat::binary)
+        this->importBinary(entries);
+    else
+        this->importText(entries);
+    // The rollups are rebuilt when they are needed next.
+    this->rollups.clear();
+    this->rollups.write();
+    unlink((this->path + "/search").c_str());
+}
+
+/* Merge into the segments of the text format. Segments that end before the
+ * first imported entry are kept, the others are streamed and written anew
+ * under new names. */
+void LogList::importText(vector<LogEntry>& entries) {
+    size_t count = this->segments.size();
+    size_t kept = 0;
+    while (kept + 1 < count &&
+                this->segments[kept + 1].first <= entries[0].getTime())
+        kept++;
+    vector<Segment> result(this->segments.begin(),
+                           this->segments.begin() + kept);
+    // The old names stay in use until the manifest is replaced.
+    vector<Segment> used(this->segments);
+    vector<string> created;
+    // The segment that is written and the month it was begun in
+    int fd = -1;
+    Segment current;
+    string month;
+    string buffer;
+    bool active = false;
+    size_t next = 0;
+
+    auto flush = [&]() {
+        writeAll(fd, buffer, -1);
+        buffer.clear();
+    };
+    auto finish = [&]() {
+        if (fd < 0)
+            return;
+        flush();
+        fsync(fd);
+        close(fd);
+        fd = -1;
+        result.push_back(current);
+    };
+    auto emit = [&](LogEntry& entry, bool imported) {
+        checkImportStep(active, entry, imported);
+        dt::time_point time = entry.getTime();
+        if (fd < 0 || (entry.type() == LogEntryType::start &&
+                       segmentName(time) != month)) {
+            finish();
+            current.name = newSegmentName(used, time);
+            current.first = time;
+            used.push_back(current);
+            created.push_back(current.name);
+            month = segmentName(time);
+            fd = open((this->path + "/" + current.name).c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                throw CorruptedFileException("Could not create "
+                                             +current.name);
+        }
+        current.last = time;
+        current.active = active;
+        entry.appendLine(buffer);
+        if (buffer.size() >= (1 << 20))
+            flush();
+    };
+
+    try {
+        vector<ParseTask> ranges(count - kept);
+        for (size_t i=kept; i<count; i++) {
+            ranges[i - kept].segment = i;
+            ranges[i - kept].from = 0;
+            ranges[i - kept].to = this->mapSegment(i)->getSize();
+        }
+        this->streamRanges(ranges, [&](EntryColumns& piece) {
+            for (size_t i=0; i<piece.size(); i++) {
+                LogEntry entry = this->getEntry(piece, i);
+                while (next < entries.size() &&
+                            entries[next].getTime() < entry.getTime())
+                    emit(entries[next++], true);
+                emit(entry, false);
+            }
+        });
+        while (next < entries.size())
+            emit(entries[next++], true);
+        finish();
+        writeManifest(this->path, result);
+    } catch (CustomException& ex) {
+        if (fd >= 0)
+            close(fd);
+        for (const string& name : created)
+            unlink((this->path + "/" + name).c_str());
+        throw;
+    }
+    // The new manifest is in place, the replaced segments are not used
+    // anymore.
+    for (size_t i=kept; i<count; i++) {
+        unlink((this->path + "/" + this->segments[i].name).c_str());
+        unlink((this->path + "/" + this->segments[i].name + ".idx").c_str());
+    }
+}
+
+/* Merge into the files of the binary format. The notes of the imported
+ * entries are appended to 'logs.notes', which leaves the old records valid,
+ * and a new 'logs.bin' replaces the old one. */
+void LogList::importBinary(vector<LogEntry>& entries) {
+    string heap;
+    string tmpName = this->path + "/logs.bin.tmp";
+    int fd = open(tmpName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644);
+    if (fd < 0)
+        throw CorruptedFileException("Could not create logs.bin.tmp");
+    string buffer = binaryHeader();
+    bool active = false;
+    size_t next = 0;
+
+    auto add = [&](LogEntry& entry, size_t offset, size_t length,
+                   bool imported) {
+        checkImportStep(active, entry, imported);
+        BinaryRecord record = binaryRecord(entry.type(), entry.getTime(),
+                                           offset, length);
+        buffer.append((const char *) &record, sizeof(record));
+        if (buffer.size() >= (1 << 20)) {
+            writeAll(fd, buffer, -1);
+            buffer.clear();
+        }
+    };
+    auto addImported = [&](LogEntry& entry) {
+        std::string_view note = entry.viewNote();
+        add(entry, this->savedNotes + heap.size(), note.size(), true);
+        heap.append(note);
+    };
+
+    try {
+        for (size_t i=0; i<this->entries.size(); i++) {
+            LogEntry entry = this->getEntry(i);
+            while (next < entries.size() &&
+                        entries[next].getTime() < entry.getTime())
+                addImported(entries[next++]);
+            add(entry, this->entries.noteOffsets[i],
+                this->entries.noteLengths[i], false);
+        }
+        while (next < entries.size())
+            addImported(entries[next++]);
+        writeAll(fd, buffer, -1);
+        fsync(fd);
+        close(fd);
+        fd = -1;
+        writeAll(this->notesFd, heap, this->savedNotes);
+        fsync(this->notesFd);
+        if (rename(tmpName.c_str(), (this->path + "/logs.bin").c_str()) != 0)
+            throw CorruptedFileException("Could not replace logs.bin");
+    } catch (CustomException& ex) {
+        if (fd >= 0)
+            close(fd);
+        unlink(tmpName.c_str());
+        throw;
+    }
+}
@@ -0,0 +1,171 @@
+/* Index methods
+ */
+
+// The file starts with this, followed by the covered size and the records.
+const char INDEXMAGIC[8] = {'J','L','I','D','X','0','0','1'};
+const size_t INDEXHEADERSIZE = 16;
+const size_t INDEXRECORDSIZE = 16;
+
+TimeIndex::TimeIndex() {
+    this->covered = 0;
+    this->stored = 0;
+}
+
+void TimeIndex::setFile(const string& filename) {
+    this->filename = filename;
+}
+
+/* Read the index file. Returns false if there is none or it is broken. */
+bool TimeIndex::read() {
+    this->days.clear();
+    this->offsets.clear();
+    this->covered = 0;
+    this->stored = 0;
+    std::ifstream file(this->filename, std::ios::binary);
+    char magic[8];
+    if (! file.read(magic, 8) || memcmp(magic, INDEXMAGIC, 8) != 0)
+        return false;
+    if (! file.read((char *) &this->covered, 8))
+        return false;
+    int64_t day;
+    uint64_t offset;
+    while (file.read((char *) &day, 8) && file.read((char *) &offset, 8)) {
+        // Records behind the covered part were not completely written.
+        if (offset >= this->covered)
+            break;
+        this->days.push_back(day);
+        this->offsets.push_back(offset);
+    }
+    this->stored = this->days.size();
+    return true;
+}
+
+/* Write the records that are not stored yet, then the header. Writing the
+ * header last keeps the file valid if this is interrupted. */
+void TimeIndex::write() {
+    int fd = open(this->filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return;
+    string records;
+    for (size_t i=this->stored; i<this->days.size(); i++) {
+        records.append((const char *) &this->days[i], 8);
+        records.append((const char *) &this->offsets[i], 8);
+    }
+    string header(INDEXMAGIC, 8);
+    header.append((const char *) &this->covered, 8);
+    try {
+        size_t end = INDEXHEADERSIZE + this->stored * INDEXRECORDSIZE;
+        writeAll(fd, records, end);
+        if (ftruncate(fd, end + records.size()) == 0) {
+            writeAll(fd, header, 0);
+            this->stored = this->days.size();
+        }
+    } catch (CorruptedFileException& ex) {
+        // The index is rebuilt when it is needed.
+    }
+    close(fd);
+}
+
+/* Add the complete lines between the given offsets of the logs. The data
+ * points to the logs at offset base. Returns false if a line has no date or
+ * the days are not sorted. */
+bool TimeIndex::addLines(const char *data, size_t base, size_t end) {
+    size_t pos = this->covered;
+    while (pos < end) {
+        const char *lineBegin = data + (pos - base);
+        const char *lineEnd = (const char *) memchr(lineBegin, '\n',
+                                                    end - pos);
+        if (! lineEnd || lineEnd == lineBegin)
+            break;
+        long long day;
+        if (lineEnd - lineBegin < 10 || !dt::parseDayNumber(lineBegin, day))
+            return false;
+        if (this->days.empty() || day > this->days.back()) {
+            this->days.push_back(day);
+            this->offsets.push_back(pos);
+        }
+        else if (day < this->days.back()) {
+            return false;
+        }
+        pos += lineEnd - lineBegin + 1;
+        this->covered = pos;
+    }
+    return true;
+}
+
+/* Index the whole logs again. */
+bool TimeIndex::rebuild(const char *data, size_t size) {
+    this->days.clear();
+    this->offsets.clear();
+    this->covered = 0;
+    this->stored = 0;
+    return this->addLines(data, 0, size);
+}
+
+/* Load the index for the given logs, check that it fits them and index what
+ * is missing. Returns false if the logs can not be indexed. */
+bool TimeIndex::prepare(const char *data, size_t size) {
+    bool valid = this->read() && this->covered <= size &&
+                 (this->covered == 0 || data[this->covered - 1] == '\n');
+    // Spot check that the last day still starts where it is expected.
+    if (valid && ! this->days.empty()) {
+        size_t offset = this->offsets.back();
+        long long day;
+        valid = (offset == 0 || data[offset - 1] == '\n') &&
+                offset + 10 <= size &&
+                dt::parseDayNumber(data + offset, day) &&
+                day == this->days.back();
+    }
+    uint64_t oldCovered = this->covered;
+    if (! valid) {
+        if (! this->rebuild(data, size))
+            return false;
+    }
+    else if (! this->addLines(data, 0, size)) {
+        return false;
+    }
+    if (! valid || this->covered != oldCovered) {
+        this->write();
+    }
+    return true;
+}
+
+/* Offset of the first entry on or after the given day. */
+size_t TimeIndex::findFirst(int64_t day) {
+    auto it = std::lower_bound(this->days.begin(), this->days.end(), day);
+    if (it == this->days.end())
+        return this->covered;
+    return this->offsets[it - this->days.begin()];
+}
+
+/* Offset behind the last entry on or before the given day. Entries that are
+ * not covered by the index may belong to it, so the size of the logs is
+ * returned then. */
+size_t TimeIndex::findEnd(int64_t day, size_t size) {
+    size_t res = this->findFirst(day + 1);
+    if (res >= this->covered)
+        return size;
+    return res;
+}
+
+/* Update the index after the given text was written to the logs at the
+ * given offset. Everything after the offset was replaced. If there is no
+ * index yet or it does not cover the logs up to the offset, nothing is done,
+ * it is brought up to date when it is used next. */
+void TimeIndex::update(const string& text, size_t offset) {
+    if (! this->read() || this->covered < offset)
+        return;
+    // Drop what was replaced.
+    while (! this->offsets.empty() && this->offsets.back() >= offset) {
+        this->days.pop_back();
+        this->offsets.pop_back();
+    }
+    this->stored = std::min(this->stored, this->days.size());
+    this->covered = offset;
+    if (! this->addLines(text.data(), offset, offset + text.size())) {
+        // Leave it to be rebuilt.
+        unlink(this->filename.c_str());
+        return;
+    }
+    this->write();
+}
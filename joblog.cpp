@@ -6,11 +6,27 @@
 
 
 #include <string.h>   // string
+#include <string_view> // string views
 #include <vector>     // vector
+#include <algorithm>  // lower_bound
 #include <iostream>   // command line in & out
 #include <fstream>    // file in & out
 #include <sys/stat.h> // mkdir
+#include <sys/mman.h> // mmap
+#include <sys/file.h> // flock
+#include <sys/socket.h> // sockets
+#include <sys/un.h>   // unix domain sockets
+#include <signal.h>   // signals
+#include <fcntl.h>    // open
+#include <unistd.h>   // read, write, close
+#include <errno.h>    // errno
 #include <exception>  // exceptions
+#include <thread>     // parallel parsing
+#include <atomic>     // atomic counter
+#include <functional> // callbacks
+#include <unordered_map> // search terms
+#include <sys/resource.h> // peak memory
+#include <dirent.h>   // directory walks
 
 #include "datetime.cpp"
 
@@ -25,13 +41,34 @@ namespace dt = DateTime;
 const string SAVEPATH = ".joblog";
 const int SEARCHDEPTH = 10;
 
-const std::ios_base::openmode FILEMODE = std::fstream::in | std::fstream::out;
+#include "profilemethods.cpp"
+
+#include "filemethods.cpp"
+
+#include "indexmethods.cpp"
+
+#include "rollupmethods.cpp"
 
 #include "coremethods.cpp"
 
+#include "segmentmethods.cpp"
+
+#include "binarymethods.cpp"
+
+#include "importmethods.cpp"
+
+#include "checkmethods.cpp"
+
+#include "reportmethods.cpp"
+
+#include "searchmethods.cpp"
+
+#include "daemonmethods.cpp"
+
 #include "uimethods.cpp"
 
 
+#ifndef JOBLOG_NO_MAIN
 int main(int argc, char* argv[]) {
     vector<string> args;
     for (int i=1; i<argc; i++) {
@@ -39,3 +76,4 @@ int main(int argc, char* argv[]) {
     }
     return commandLineInterface(args);
 }
+#endif
@@ -35,53 +35,315 @@ public:
 
 
 // -----------------------------------------------------------------------------
-//  LogEntry and subclasses
+//  Profiling
 // -----------------------------------------------------------------------------
 
-enum class LogEntryType {
+/* The phases the time of a command is split into. */
+enum class Phase : int {
+    other, search, lock, read, parse, check, query, output, save, count
+};
+
+/* Collects timings and counters for --profile. The time is charged to one
+ * phase at a time, a nested phase pauses the one around it. Only the thread
+ * that enabled the profiler is timed, the counters count for all threads.
+ * While the profiler is not enabled, nothing is measured. */
+class Profiler {
+private:
+    static std::chrono::steady_clock::time_point begin;
+    static std::chrono::steady_clock::time_point lastSwitch;
+    static Phase current;
+    static double seconds[(int) Phase::count];
+public:
+    static bool enabled;
+    static std::thread::id owner;
+    static std::atomic<size_t> linesParsed;
+    static std::atomic<size_t> bytesRead;
+    static std::atomic<size_t> bytesWritten;
+    static std::atomic<size_t> allocations;
+    static void enable();
+    static Phase enter(Phase);
+    static void report(std::ostream&);
+};
+
+/* Charges the time until it is destroyed to the given phase. */
+class ProfileScope {
+private:
+    bool active;
+    Phase previous;
+public:
+    ProfileScope(Phase);
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+    ~ProfileScope();
+};
+
+
+// -----------------------------------------------------------------------------
+//  Files
+// -----------------------------------------------------------------------------
+
+/* A file mapped into memory for reading. Nothing is copied, the pages are
+ * loaded by the system when they are accessed. */
+class MappedFile {
+private:
+    const char *data;
+    size_t size;
+public:
+    MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+    void map(int);
+    void unmap();
+    const char *getData();
+    size_t getSize();
+};
+
+
+/* What identifies a version of a file, to tell whether it was changed. */
+struct FileStamp {
+    ino_t inode;
+    off_t size;
+    struct timespec modified;
+    
+    bool operator==(const FileStamp&) const;
+};
+
+/* An advisory lock on the file 'lock' in the directory of the logs. It is
+ * released when the object is destroyed. */
+class FileLock {
+private:
+    int fd;
+    bool exclusive;
+public:
+    FileLock();
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+    ~FileLock();
+    void acquire(const string&, bool);
+    void release();
+    bool isExclusive();
+};
+
+
+/* Collects output in a large buffer that is written to a file descriptor
+ * in big blocks. Dates and durations are formatted right into the
+ * buffer. */
+class OutputBuffer {
+private:
+    int fd;
+    char *data;
+    size_t used;
+public:
+    OutputBuffer(int);
+    OutputBuffer(const OutputBuffer&) = delete;
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+    ~OutputBuffer();
+    void put(std::string_view);
+    void put(char);
+    void putDay(const dt::time_point&);
+    void putDuration(const dt::duration&);
+    void flush();
+};
+
+
+/* The sidecar file 'logs.idx'. It maps each day to the offset of the first
+ * entry of that day in 'logs', so that a range of time can be read without
+ * parsing the entries before it. The index covers the logs up to some
+ * offset, entries behind it are indexed when the index is used. */
+class TimeIndex {
+private:
+    string filename;
+    vector<int64_t> days;
+    vector<uint64_t> offsets;
+    uint64_t covered;
+    // Number of records that are stored in the file.
+    size_t stored;
+protected:
+    bool read();
+    void write();
+    bool addLines(const char *, size_t, size_t);
+    bool rebuild(const char *, size_t);
+public:
+    TimeIndex();
+    void setFile(const string&);
+    bool prepare(const char *, size_t);
+    size_t findFirst(int64_t);
+    size_t findEnd(int64_t, size_t);
+    void update(const string&, size_t);
+};
+
+
+/* The sidecar file 'rollups'. It holds the time worked on each day by the
+ * sessions that were ended, so that totals over long ranges need no
+ * entries. Sessions over midnight are split between the days. */
+class Rollups {
+private:
+    string filename;
+    vector<int64_t> days;
+    vector<int64_t> worked;
+    // End of the last session counted, in seconds since 01.01.1970.
+    int64_t through;
+    // Digest of the stamps of the files the sessions were counted from.
+    uint64_t source;
+    // Records before this one are stored in the file unchanged.
+    size_t unchanged;
+protected:
+    void add(int64_t, int64_t, int);
+public:
+    Rollups();
+    void setFile(const string&);
+    bool read();
+    void write();
+    void clear();
+    int64_t getThrough();
+    uint64_t getSource();
+    void setSource(uint64_t);
+    void addSession(const dt::time_point&, const dt::time_point&);
+    void moveEnd(const dt::time_point&, const dt::time_point&,
+                 const dt::time_point&);
+    dt::duration sum(int64_t, int64_t);
+};
+
+
+/* The times of the log entries each term occurs in. */
+typedef std::unordered_map<string, vector<int64_t>> Postings;
+
+/* The sidecar file 'search', an inverted index of the notes. A sorted table
+ * of the terms points to their postings, the times of the logs with the
+ * term, stored as differences in variable length. Logs that were added
+ * later are appended to the file as they are, until they are merged into
+ * the table. The index is current if it has seen the last entry. */
+class SearchIndex {
+private:
+    string filename;
+    MappedFile mapping;
+    // Time of the last entry seen, in seconds since 01.01.1970.
+    int64_t through;
+    uint64_t terms;
+    // End of the table and the postings, where the appended logs begin.
+    uint64_t tableEnd;
+    uint64_t end;
+protected:
+    std::string_view termAt(uint64_t);
+    void findInTable(const string&, vector<int64_t>&);
+    void collect(Postings&);
+    void compact();
+public:
+    SearchIndex();
+    void setFile(const string&);
+    bool read();
+    int64_t getThrough();
+    vector<int64_t> find(const string&);
+    void append(const vector<int64_t>&, const vector<std::string_view>&,
+                int64_t);
+    static void write(const string&, Postings&, int64_t);
+};
+
+
+// -----------------------------------------------------------------------------
+//  LogEntry and its storage
+// -----------------------------------------------------------------------------
+
+enum class LogEntryType : uint8_t {
     start, end, log
 };
 
-/* This is the superclass to all entries stored in the logfile. */
+/* A view on one entry stored in the logfile. Notes are not copied, they
+ * point to where the entry is stored. */
 class LogEntry {
 private:
     dt::time_point time;
-protected:
-    LogEntry();
-    LogEntry(const dt::time_point&);
+    LogEntryType kind;
+    std::string_view note;
 public:
-    static LogEntry * parse(const string&);
-    virtual string toString();
-    virtual LogEntryType type() = 0;
+    LogEntry(LogEntryType, const dt::time_point&, std::string_view);
+    static LogEntry parse(std::string_view, const dt::time_point&);
+    string toString();
+    void appendLine(string&);
+    LogEntryType type();
     dt::time_point getTime();
-    virtual ~LogEntry() = default;
+    std::string_view viewNote();
+    string getNote();
 };
 
-class LogEntryStart : public LogEntry {
+/* Stores strings back to back in few large blocks, so that they do not need
+ * an allocation each. Strings are addressed by their offset in the pool.
+ * Existing memory, like a mapped file, can be added as a block without
+ * copying it. */
+class StringPool {
+private:
+    struct Block {
+        size_t base;
+        char *data;
+        size_t size;
+        bool owned;
+    };
+    vector<Block> blocks;
+    // Bytes used in the last block, if it is owned.
+    size_t used;
+    // Offset of the next string.
+    size_t end;
 public:
-    LogEntryStart() : LogEntry() {};
-    LogEntryStart(const dt::time_point& time) : LogEntry(time) {};
-    virtual LogEntryType type() { return LogEntryType::start; };
-    virtual string toString();
+    StringPool();
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+    ~StringPool();
+    size_t addExternal(const char *, size_t);
+    size_t add(std::string_view);
+    std::string_view get(size_t, size_t);
+    size_t size();
+    string copySince(size_t);
 };
 
-class LogEntryEnd : public LogEntry {
+/* The entries of a LogList, stored column by column so that scans over
+ * times and types run over contiguous memory. Notes are given as offsets
+ * into a StringPool. */
+class EntryColumns {
 public:
-    LogEntryEnd() : LogEntry() {};
-    LogEntryEnd(const dt::time_point& time) : LogEntry(time) {};
-    virtual LogEntryType type() { return LogEntryType::end; };
-    virtual string toString();
+    vector<dt::time_point> times;
+    vector<LogEntryType> types;
+    vector<size_t> noteOffsets;
+    vector<uint32_t> noteLengths;
+    
+    size_t size();
+    void reserve(size_t);
+    void push(LogEntryType, const dt::time_point&, size_t, uint32_t);
+    void pop();
+    void append(const EntryColumns&);
+    void swap(EntryColumns&);
 };
 
-class LogEntryLog : public LogEntry {
+
+/* The sessions that were ended, in order, with the time worked before each
+ * of them. The time worked between two dates takes two binary searches, only
+ * the sessions at the edges are cut off. The table is built from the entries
+ * that were read and grows with them. Times are in ticks of dt::duration. */
+class SessionTable {
 private:
-    string note;
+    vector<int64_t> begins;
+    vector<int64_t> ends;
+    // The time worked by the sessions before each one, and by all of them.
+    vector<int64_t> before;
+    // Number of entries that were paired, the start of a session that is
+    // not ended yet with its position and the position of the end of the
+    // last session.
+    size_t covered;
+    int64_t open;
+    size_t openAt;
+    bool running;
+    size_t lastEnd;
+    // The first start seen and its position. No session before it is known.
+    int64_t firstStart;
+    size_t firstStartAt;
 public:
-    LogEntryLog(const string&);
-    LogEntryLog(const dt::time_point&, const string&);
-    virtual LogEntryType type() { return LogEntryType::log; };
-    string getNote();
-    virtual string toString();
+    SessionTable();
+    void clear();
+    bool isBuilt();
+    void update(EntryColumns&);
+    void forget(size_t);
+    bool reaches(const dt::time_point&);
+    dt::duration worked(const dt::time_point&, const dt::time_point&);
 };
 
 
@@ -89,45 +351,257 @@ public:
 //  Main Content Objects
 // -----------------------------------------------------------------------------
 
-/* This class is associated with the file 'logs' and stores the list of events.
- * It offers tools to add and list events. */
+enum class LogFormat {
+    text, binary
+};
+
+/* One file of the text format, as listed in the file 'manifest'. */
+struct Segment {
+    string name;
+    dt::time_point first;
+    dt::time_point last;
+    bool active;
+};
+
+/* A range of a segment that is parsed on its own, possibly by another
+ * thread. */
+struct ParseTask {
+    size_t segment;
+    const char *data;
+    size_t base;
+    size_t from;
+    size_t to;
+    EntryColumns entries;
+    // Whether an empty line ended the list in this range.
+    bool stopped;
+    // Whether only starts and ends are needed. Logs are passed over
+    // without parsing them.
+    bool skipLogs;
+    std::exception_ptr error;
+};
+
+/* How far the logs were checked, as stored in the file 'checked'. The
+ * checked part ends at an offset in a segment, or in 'logs.bin', and has a
+ * checksum to tell whether it was changed since. */
+struct Checkpoint {
+    string file;
+    uint64_t offset;
+    uint64_t checksum;
+    // The time of the last entry and whether a session was running there
+    int64_t last;
+    bool active;
+};
+
+/* A session with the logs in it that matched a search. While the session
+ * is running, the end is its start. */
+struct SearchHit {
+    LogEntry start;
+    LogEntry end;
+    bool ended;
+    vector<LogEntry> logs;
+};
+
+/* This class is associated with the logs and stores the list of events. It
+ * offers tools to add and list events. The events are stored as text in
+ * segments per month, or in the binary format in the files 'logs.bin' and
+ * 'logs.notes'. The files are mapped into memory and the notes of the
+ * entries refer to them. */
 class LogList {
 private:
-    std::fstream *file;
+    string path;
+    LogFormat format;
+    // The newest segment or 'logs.bin'
+    int fd;
+    StringPool notes;
+    // The segments of the text format and the index of the newest one
+    vector<Segment> segments;
+    vector<MappedFile *> segmentMappings;
+    vector<size_t> segmentBases;
+    TimeIndex index;
+    Rollups rollups;
+    SessionTable sessions;
+    SearchIndex searchIndex;
+    // The time of an end that was moved, until the rollups know it.
+    dt::time_point movedEnd;
+    bool endMoved;
+    // The files of the binary format and how much of the note heap is
+    // written.
+    MappedFile mapping;
+    int notesFd;
+    MappedFile notesMapping;
+    size_t savedNotes;
     int needsToBeWritten;
-    vector<LogEntry *> entries;
+    // Position of the first entry that replaced one in the files.
+    size_t amended;
+    EntryColumns entries;
     bool active;
+    bool complete;
+    // Offset in the newest segment of the first entry that was read of it
+    // and the position of that entry.
+    size_t begin;
+    size_t firstEntry;
+    // The files as they were when they were last read or written
+    vector<FileStamp> stamps;
 protected:
+    vector<FileStamp> stampFiles();
     void updateFileState();
+    void checkOrder(const dt::time_point&);
+    void replaceLast(const dt::time_point&);
+    void addEntry(LogEntryType, const dt::time_point&, std::string_view);
+    void updateActive();
+    void openSegments();
+    MappedFile *mapSegment(size_t);
+    bool needsNewSegment(const dt::time_point&);
+    void addSegment(size_t);
+    void parseRange(size_t, size_t, size_t, EntryColumns&);
+    void parseRanges(vector<ParseTask>&, EntryColumns&);
+    void streamRanges(vector<ParseTask>&,
+                      const std::function<void(EntryColumns&)>&);
+    static void parseTask(ParseTask&);
+    void loadRecent();
+    void loadBinary();
+    void saveText();
+    void writeText(const string&, off_t, bool);
+    off_t findLastLine(off_t);
+    void saveBinary();
+    void importText(vector<LogEntry>&);
+    void importBinary(vector<LogEntry>&);
+    LogEntry getEntry(EntryColumns&, size_t);
+    bool prepareRollups();
+    void rebuildRollups();
+    void updateRollups(uint64_t);
+    bool runningAt(const dt::time_point&, dt::time_point&);
+    dt::duration workedIn(vector<LogEntry>&, const dt::time_point&,
+                          const dt::time_point&);
+    void pick(EntryColumns&, dt::time_point&, dt::time_point&, bool&,
+              const std::function<void(LogEntry&)>&);
+    static void checkEntries(EntryColumns&, size_t, bool&, dt::time_point&);
+    bool readCheckpoint(Checkpoint&);
+    void writeCheckpoint(const Checkpoint&);
+    uint64_t hashSegments(size_t, size_t, uint64_t);
+    bool checkSince(Checkpoint&);
+    Checkpoint checkpointAtEnd(bool, const dt::time_point&);
+    int64_t lastTime();
+    bool prepareSearchIndex();
+    void rebuildSearchIndex();
+    void updateSearchIndex();
+    void entriesBetween(const dt::time_point&, const dt::time_point&,
+                        vector<LogEntry>&);
+    void sessionAround(int64_t, vector<LogEntry>&);
 public:
-    LogList(std::fstream *);
+    static bool existsIn(const string&);
+    static bool needsSplitting(const string&);
+    static bool needsRecovery(const string&);
+    static void create(const string&, LogFormat);
+    LogList(const string&, bool);
     ~LogList();
+    LogFormat getFormat();
+    void convert(LogFormat);
+    void import(vector<LogEntry>&);
+    void loadAll();
+    bool isComplete();
+    bool isOutdated();
     bool isActive();
     void check();
     void save();
     void start(bool);
+    void start(bool, const dt::time_point&);
     void log(string);
+    void log(string, const dt::time_point&);
     void end(bool);
-    LogEntry *getLastEntry();
-    LogEntryStart *getLastStart();
-    vector<LogEntry *> list(dt::time_point&, dt::time_point&, bool&);
+    void end(bool, const dt::time_point&);
+    size_t size();
+    LogEntry getEntry(size_t);
+    LogEntry getLastEntry();
+    LogEntry getLastStart();
+    vector<LogEntry> list(dt::time_point&, dt::time_point&, bool&);
+    void scan(dt::time_point&, dt::time_point&, bool&,
+              const std::function<void(LogEntry&)>&);
+    dt::duration workedTime(dt::time_point&, dt::time_point&);
+    void sessionsIn(dt::time_point&, dt::time_point&, vector<int64_t>&,
+                    vector<int64_t>&);
+    vector<SearchHit> search(const vector<string>&);
+};
+
+// -----------------------------------------------------------------------------
+//  Reports
+// -----------------------------------------------------------------------------
+
+enum class ReportUnit {
+    day, week, month
+};
+
+/* The sums of a report over one day, week or month. Days are counted from
+ * 01.01.1970. */
+struct ReportRow {
+    long long firstDay;
+    long long lastDay;
+    // Seconds worked
+    int64_t worked;
+    int daysWorked;
+    // Days from Monday to Friday
+    int workDays;
 };
 
+/* Sums up sessions per day over a range of days. Weeks and months are
+ * summed up from the days. */
+class Report {
+private:
+    long long firstDay;
+    // Seconds worked on each day of the range
+    vector<int64_t> daily;
+public:
+    Report(long long, long long);
+    void addSessions(const vector<int64_t>&, const vector<int64_t>&);
+    vector<ReportRow> rows(ReportUnit);
+    static string label(ReportUnit, long long);
+};
+
+
 /* This is the main class of this program. It stores pointers to the content
  * classes. */
 class Joblog {
 private:
     string path;
     bool check;
+    bool writing;
+    bool locked;
+    FileLock lock;
     LogList *loglist;
 protected:
-    void loadLoglist();
+    void loadLoglist(bool);
 public:
     Joblog();
     ~Joblog();
     void setPath(string);
-    int init();
+    string getPath();
+    void unload();
+    int init(LogFormat);
     void doChecks();
+    void requestWriting();
     void save();
     LogList *getLogList();
+    LogList *getRecentLogList();
+};
+
+
+// -----------------------------------------------------------------------------
+//  Daemon
+// -----------------------------------------------------------------------------
+
+/* Keeps the logs in memory and runs the commands that clients send over the
+ * socket in the directory of the logs. One client is served at a time. */
+class Daemon {
+private:
+    Joblog *joblog;
+    string socketPath;
+    int listenFd;
+protected:
+    void serve(int);
+public:
+    Daemon(Joblog *);
+    Daemon(const Daemon&) = delete;
+    Daemon& operator=(const Daemon&) = delete;
+    ~Daemon();
+    void run();
 };
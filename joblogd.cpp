@@ -0,0 +1,45 @@
+/* joblogd - Keeps the logs of joblog in memory
+ *
+ * Serves the logs of one directory over a socket in it. While it runs,
+ * joblog lets it run the commands start, end, log, state and list, which
+ * saves reading the logs on every call.
+ */
+
+#define JOBLOG_NO_MAIN
+#include "joblog.cpp"
+
+const string DAEMON_HELPMSG(
+  "Useage: joblogd [--help] [-path=<path>]\n"
+  "\n"
+  "Keep the logs in memory and run the commands of joblog on them until\n"
+  "interrupted. The logs are searched like joblog does, unless a path is\n"
+  "given. Changes by others to the files are noticed."
+);
+
+int main(int argc, char* argv[]) {
+    Joblog joblog;
+    for (int i=1; i<argc; i++) {
+        string arg(argv[i]);
+        if (arg.compare(0, 6, "-path=") == 0) {
+            joblog.setPath(arg.substr(6));
+        }
+        else if (arg.compare("--help") == 0) {
+            std::cout << DAEMON_HELPMSG << std::endl;
+            return 0;
+        }
+        else {
+            std::cout << "Unknown argument '" << arg << "'" << std::endl;
+            std::cout << "Use --help to see valid arguments." << std::endl;
+            return 2;
+        }
+    }
+    try {
+        Daemon daemon(&joblog);
+        daemon.run();
+    } catch (CustomException& ex) {
+        std::cout << "The daemon could not be started. The exception "
+                     "message is:\n'" << ex.what() << "'" << std::endl;
+        return 2;
+    }
+    return 0;
+}
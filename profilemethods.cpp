@@ -0,0 +1,143 @@
+/* Profiling methods
+ */
+
+std::chrono::steady_clock::time_point Profiler::begin;
+std::chrono::steady_clock::time_point Profiler::lastSwitch;
+Phase Profiler::current = Phase::other;
+double Profiler::seconds[(int) Phase::count] = {};
+bool Profiler::enabled = false;
+std::thread::id Profiler::owner;
+std::atomic<size_t> Profiler::linesParsed(0);
+std::atomic<size_t> Profiler::bytesRead(0);
+std::atomic<size_t> Profiler::bytesWritten(0);
+std::atomic<size_t> Profiler::allocations(0);
+
+const char *PHASENAMES[(int) Phase::count] = {
+    "other", "search", "lock", "read", "parse", "check", "query", "output",
+    "save"
+};
+
+/* Count heap allocations while profiling. Everything else is left to the C
+ * library, like the default operators do. All forms are replaced, so that
+ * memory never goes from one allocator to the other. The deletes are not
+ * inlined, otherwise the compiler sees free() on memory from new and warns
+ * about a mismatch that is none. */
+void *profiledAlloc(size_t size) {
+    if (Profiler::enabled)
+        Profiler::allocations.fetch_add(1, std::memory_order_relaxed);
+    return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size) {
+    void *res = profiledAlloc(size);
+    if (! res)
+        throw std::bad_alloc();
+    return res;
+}
+
+void *operator new[](size_t size) {
+    void *res = profiledAlloc(size);
+    if (! res)
+        throw std::bad_alloc();
+    return res;
+}
+
+void *operator new(size_t size, const std::nothrow_t&) noexcept {
+    return profiledAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return profiledAlloc(size);
+}
+
+__attribute__((noinline))
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline))
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline))
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline))
+void operator delete[](void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline))
+void operator delete(void *ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline))
+void operator delete[](void *ptr, const std::nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void Profiler::enable() {
+    Profiler::enabled = true;
+    Profiler::owner = std::this_thread::get_id();
+    Profiler::begin = std::chrono::steady_clock::now();
+    Profiler::lastSwitch = Profiler::begin;
+}
+
+/* Charge the time since the last switch to the current phase and continue
+ * with the given one. Returns the phase that was current before. */
+Phase Profiler::enter(Phase phase) {
+    auto now = std::chrono::steady_clock::now();
+    Profiler::seconds[(int) Profiler::current] +=
+            std::chrono::duration<double>(now - Profiler::lastSwitch).count();
+    Profiler::lastSwitch = now;
+    Phase previous = Profiler::current;
+    Profiler::current = phase;
+    return previous;
+}
+
+/* Print the time of each phase and the counters. */
+void Profiler::report(std::ostream& out) {
+    Profiler::enter(Profiler::current);
+    double total = std::chrono::duration<double>(
+            Profiler::lastSwitch - Profiler::begin).count();
+    struct rusage usage;
+    long peak = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+    char line[512];
+    out << "Profile:\n";
+    for (int i=1; i<=(int) Phase::count; i++) {
+        // The time that belongs to no phase goes last.
+        int phase = i % (int) Phase::count;
+        snprintf(line, sizeof(line), "  %-14s %10.3f ms\n", PHASENAMES[phase],
+                 Profiler::seconds[phase] * 1000);
+        out << line;
+    }
+    snprintf(line, sizeof(line), "  %-14s %10.3f ms\n", "total",
+             total * 1000);
+    out << line;
+    snprintf(line, sizeof(line),
+             "  %-14s %10zu\n  %-14s %10zu\n  %-14s %10zu\n"
+             "  %-14s %10zu\n  %-14s %10ld KiB\n",
+             "lines parsed", Profiler::linesParsed.load(),
+             "bytes read", Profiler::bytesRead.load(),
+             "bytes written", Profiler::bytesWritten.load(),
+             "allocations", Profiler::allocations.load(),
+             "peak RSS", peak);
+    out << line << std::flush;
+}
+
+ProfileScope::ProfileScope(Phase phase) {
+    this->active = Profiler::enabled &&
+                   std::this_thread::get_id() == Profiler::owner;
+    this->previous = Phase::other;
+    if (this->active)
+        this->previous = Profiler::enter(phase);
+}
+
+ProfileScope::~ProfileScope() {
+    if (this->active)
+        Profiler::enter(this->previous);
+}
@@ -0,0 +1,123 @@
+/* Report methods
+ *
+ * Sessions are split at midnight and summed up per day. The days of a week
+ * or a month lie next to each other, so their sums are plain loops over a
+ * part of the array. Where weeks and months begin is computed from the day
+ * numbers, without converting any time.
+ */
+
+/* The day of the week, 0 is Monday. 01.01.1970 was a Thursday. */
+int weekdayOf(long long day) {
+    return (int) (((day + 3) % 7 + 7) % 7);
+}
+
+/* The first day of the bucket after the one of the given day. */
+long long nextBucket(ReportUnit unit, long long day) {
+    if (unit == ReportUnit::day)
+        return day + 1;
+    if (unit == ReportUnit::week)
+        return day - weekdayOf(day) + 7;
+    long long y;
+    unsigned m, d;
+    dt::civilFromDays(day, y, m, d);
+    return m == 12 ? dt::daysFromCivil(y + 1, 1, 1) :
+                     dt::daysFromCivil(y, m + 1, 1);
+}
+
+/* A report over the days between the given ones, both included. */
+Report::Report(long long firstDay, long long lastDay) {
+    this->firstDay = firstDay;
+    this->daily.assign(std::max(lastDay - firstDay + 1, 0LL), 0);
+}
+
+/* Add the sessions with the given beginnings and ends in seconds. */
+void Report::addSessions(const vector<int64_t>& begins,
+                         const vector<int64_t>& ends) {
+    // Sessions over midnight are split into pieces of one day.
+    vector<int64_t> pieceBegins;
+    vector<int64_t> pieceEnds;
+    vector<long long> pieceDays;
+    pieceBegins.reserve(begins.size());
+    pieceEnds.reserve(begins.size());
+    pieceDays.reserve(begins.size());
+    for (size_t i=0; i<begins.size(); i++) {
+        int64_t begin = begins[i];
+        long long day = dt::toDayNumber(dt::clock::from_time_t(begin));
+        int64_t midnight = dt::to_time_t(dt::beginOfDayNumber(day + 1));
+        while (midnight < ends[i]) {
+            pieceBegins.push_back(begin);
+            pieceEnds.push_back(midnight);
+            pieceDays.push_back(day);
+            begin = midnight;
+            day++;
+            midnight = dt::to_time_t(dt::beginOfDayNumber(day + 1));
+        }
+        pieceBegins.push_back(begin);
+        pieceEnds.push_back(ends[i]);
+        pieceDays.push_back(day);
+    }
+    // A plain loop over the contiguous times, which the compiler
+    // vectorizes.
+    size_t count = pieceBegins.size();
+    vector<int64_t> seconds(count);
+    const int64_t *b = pieceBegins.data();
+    const int64_t *e = pieceEnds.data();
+    int64_t *s = seconds.data();
+    for (size_t i=0; i<count; i++) {
+        s[i] = e[i] - b[i];
+    }
+    for (size_t i=0; i<count; i++) {
+        long long day = pieceDays[i] - this->firstDay;
+        if (day >= 0 && day < (long long) this->daily.size())
+            this->daily[day] += s[i];
+    }
+}
+
+/* Sum up the days per bucket. The first and the last bucket are cut off
+ * at the edges of the range. */
+vector<ReportRow> Report::rows(ReportUnit unit) {
+    vector<ReportRow> res;
+    long long end = this->firstDay + (long long) this->daily.size();
+    long long day = this->firstDay;
+    while (day < end) {
+        long long next = std::min(nextBucket(unit, day), end);
+        const int64_t *worked = this->daily.data() + (day - this->firstDay);
+        size_t count = next - day;
+        int64_t sum = 0;
+        int daysWorked = 0;
+        for (size_t i=0; i<count; i++) {
+            sum += worked[i];
+            daysWorked += worked[i] > 0;
+        }
+        int workDays = 0;
+        for (long long d=day; d<next; d++) {
+            workDays += weekdayOf(d) < 5;
+        }
+        res.push_back(ReportRow{day, next - 1, sum, daysWorked, workDays});
+        day = next;
+    }
+    return res;
+}
+
+/* Name the bucket that begins on the given day, like 'Mon 01.01.2024',
+ * '2024-W01' or '01.2024'. Weeks are numbered as in ISO 8601, they belong
+ * to the year their Thursday is in. */
+string Report::label(ReportUnit unit, long long day) {
+    long long y;
+    unsigned m, d;
+    char buff[dt::FORMATSIZE];
+    if (unit == ReportUnit::day) {
+        return string(buff, dt::formatDay(buff, dt::beginOfDayNumber(day))
+                            - buff);
+    }
+    if (unit == ReportUnit::week) {
+        long long thursday = day - weekdayOf(day) + 3;
+        dt::civilFromDays(thursday, y, m, d);
+        long long week = (thursday - dt::daysFromCivil(y, 1, 1)) / 7 + 1;
+        snprintf(buff, sizeof(buff), "%04lld-W%02lld", y, week);
+        return buff;
+    }
+    dt::civilFromDays(day, y, m, d);
+    snprintf(buff, sizeof(buff), "%02u.%04lld", m, y);
+    return buff;
+}
@@ -0,0 +1,247 @@
+/* Rollup methods
+ */
+
+// The file starts with this, followed by the end of the last session counted,
+// the digest of the logs counted and the records of day and seconds worked.
+const char ROLLUPMAGIC[8] = {'J','L','R','O','L','L','0','2'};
+const size_t ROLLUPHEADERSIZE = 24;
+const size_t ROLLUPRECORDSIZE = 16;
+
+Rollups::Rollups() {
+    this->through = INT64_MIN;
+    this->source = 0;
+    this->unchanged = 0;
+}
+
+void Rollups::setFile(const string& filename) {
+    this->filename = filename;
+}
+
+/* Read the rollups file. Returns false if there is none or it is broken. */
+bool Rollups::read() {
+    this->clear();
+    std::ifstream file(this->filename, std::ios::binary);
+    char magic[8];
+    if (! file.read(magic, 8) || memcmp(magic, ROLLUPMAGIC, 8) != 0)
+        return false;
+    if (! file.read((char *) &this->through, 8) ||
+            ! file.read((char *) &this->source, 8))
+        return false;
+    int64_t day;
+    int64_t seconds;
+    while (file.read((char *) &day, 8) && file.read((char *) &seconds, 8)) {
+        if (! this->days.empty() && day <= this->days.back())
+            return false;
+        this->days.push_back(day);
+        this->worked.push_back(seconds);
+    }
+    this->unchanged = this->days.size();
+    return true;
+}
+
+/* Write the records that changed, then the header. Usually only the last
+ * day or two are written. */
+void Rollups::write() {
+    int fd = open(this->filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return;
+    string records;
+    for (size_t i=this->unchanged; i<this->days.size(); i++) {
+        records.append((const char *) &this->days[i], 8);
+        records.append((const char *) &this->worked[i], 8);
+    }
+    string header(ROLLUPMAGIC, 8);
+    header.append((const char *) &this->through, 8);
+    header.append((const char *) &this->source, 8);
+    try {
+        size_t end = ROLLUPHEADERSIZE + this->unchanged * ROLLUPRECORDSIZE;
+        writeAll(fd, records, end);
+        if (ftruncate(fd, end + records.size()) == 0) {
+            writeAll(fd, header, 0);
+            this->unchanged = this->days.size();
+        }
+    } catch (CorruptedFileException& ex) {
+        // The rollups are rebuilt when they are needed.
+    }
+    close(fd);
+}
+
+/* Forget all sessions. */
+void Rollups::clear() {
+    this->days.clear();
+    this->worked.clear();
+    this->through = INT64_MIN;
+    this->source = 0;
+    this->unchanged = 0;
+}
+
+int64_t Rollups::getThrough() {
+    return this->through;
+}
+
+uint64_t Rollups::getSource() {
+    return this->source;
+}
+
+/* Remember the digest of the files the rollups were counted from. */
+void Rollups::setSource(uint64_t source) {
+    this->source = source;
+}
+
+/* Add or subtract the time between the given seconds to the days it falls
+ * on. */
+void Rollups::add(int64_t from, int64_t to, int sign) {
+    int64_t day = dt::toDayNumber(dt::clock::from_time_t(from));
+    int64_t pos = from;
+    while (pos < to) {
+        int64_t next = dt::clock::to_time_t(dt::beginOfDayNumber(day + 1));
+        if (next <= pos)
+            break;
+        int64_t part = std::min(next, to) - pos;
+        auto it = std::lower_bound(this->days.begin(), this->days.end(), day);
+        size_t i = it - this->days.begin();
+        if (it == this->days.end() || *it != day) {
+            this->days.insert(it, day);
+            this->worked.insert(this->worked.begin() + i, 0);
+        }
+        this->worked[i] += sign * part;
+        this->unchanged = std::min(this->unchanged, i);
+        pos = next;
+        day++;
+    }
+}
+
+/* Count a session, unless it ended before the last one counted. */
+void Rollups::addSession(const dt::time_point& start,
+                         const dt::time_point& end) {
+    int64_t to = dt::clock::to_time_t(end);
+    if (to <= this->through)
+        return;
+    this->add(dt::clock::to_time_t(start), to, 1);
+    this->through = to;
+}
+
+/* Change the end of the last session counted. */
+void Rollups::moveEnd(const dt::time_point& start,
+                      const dt::time_point& oldEnd,
+                      const dt::time_point& newEnd) {
+    int64_t from = dt::clock::to_time_t(start);
+    if (dt::clock::to_time_t(oldEnd) != this->through)
+        return;
+    this->add(from, this->through, -1);
+    this->through = dt::clock::to_time_t(newEnd);
+    this->add(from, this->through, 1);
+}
+
+/* The time worked on the days between the given ones, both included. */
+dt::duration Rollups::sum(int64_t firstDay, int64_t lastDay) {
+    auto first = std::lower_bound(this->days.begin(), this->days.end(),
+                                  firstDay);
+    auto last = std::upper_bound(first, this->days.end(), lastDay);
+    int64_t res = 0;
+    for (size_t i = first - this->days.begin();
+                i < (size_t) (last - this->days.begin()); i++) {
+        res += this->worked[i];
+    }
+    return dt::seconds(res);
+}
+
+
+SessionTable::SessionTable() {
+    this->clear();
+}
+
+/* Forget all sessions. */
+void SessionTable::clear() {
+    this->begins.clear();
+    this->ends.clear();
+    this->before.assign(1, 0);
+    this->covered = 0;
+    this->open = 0;
+    this->openAt = SIZE_MAX;
+    this->running = false;
+    this->lastEnd = SIZE_MAX;
+    this->firstStart = INT64_MAX;
+    this->firstStartAt = SIZE_MAX;
+}
+
+/* Tell whether any entries were paired yet. */
+bool SessionTable::isBuilt() {
+    return this->covered > 0;
+}
+
+/* Pair the entries that were added since the last update. */
+void SessionTable::update(EntryColumns& columns) {
+    const vector<LogEntryType>& types = columns.types;
+    const vector<dt::time_point>& times = columns.times;
+    for (size_t i=this->covered; i<types.size(); i++) {
+        int64_t time = times[i].time_since_epoch().count();
+        if (types[i] == LogEntryType::start) {
+            this->open = time;
+            this->openAt = i;
+            this->running = true;
+            if (this->firstStartAt == SIZE_MAX) {
+                this->firstStart = time;
+                this->firstStartAt = i;
+            }
+        }
+        else if (types[i] == LogEntryType::end && this->running) {
+            this->begins.push_back(this->open);
+            this->ends.push_back(time);
+            this->before.push_back(this->before.back() + time - this->open);
+            this->running = false;
+            this->lastEnd = i;
+        }
+    }
+    this->covered = std::max(this->covered, types.size());
+}
+
+/* Forget the entry at the given position, which has to be the last one, so
+ * that the next update reads it again. */
+void SessionTable::forget(size_t position) {
+    if (position + 1 != this->covered)
+        return;
+    if (position == this->lastEnd) {
+        this->open = this->begins.back();
+        this->running = true;
+        this->begins.pop_back();
+        this->ends.pop_back();
+        this->before.pop_back();
+        this->lastEnd = SIZE_MAX;
+    }
+    else if (position == this->openAt) {
+        this->running = false;
+        this->openAt = SIZE_MAX;
+    }
+    // The first start might be moved to a later time.
+    if (position == this->firstStartAt) {
+        this->firstStart = INT64_MAX;
+        this->firstStartAt = SIZE_MAX;
+    }
+    this->covered = position;
+}
+
+/* Tell whether all sessions after the given time are known. Sessions do not
+ * overlap, so none that was missed can reach past the first start seen. */
+bool SessionTable::reaches(const dt::time_point& from) {
+    return from.time_since_epoch().count() >= this->firstStart;
+}
+
+/* The time worked between the given dates by the sessions that were ended.
+ * Sessions at the edges are cut off there. */
+dt::duration SessionTable::worked(const dt::time_point& from,
+                                  const dt::time_point& to) {
+    int64_t a = from.time_since_epoch().count();
+    int64_t b = to.time_since_epoch().count();
+    // The sessions in [first, last) end after 'from' and begin before 'to'.
+    size_t first = std::upper_bound(this->ends.begin(), this->ends.end(), a)
+                   - this->ends.begin();
+    size_t last = std::lower_bound(this->begins.begin(), this->begins.end(),
+                                   b) - this->begins.begin();
+    if (first >= last)
+        return dt::duration(0);
+    int64_t res = this->before[last] - this->before[first];
+    res -= std::max(a - this->begins[first], (int64_t) 0);
+    res -= std::max(this->ends[last - 1] - b, (int64_t) 0);
+    return dt::duration(res);
+}
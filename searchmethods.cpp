@@ -0,0 +1,500 @@
+/* Search methods
+ *
+ * The file 'search' starts with a header, followed by a table with a record
+ * per term, sorted by term. A record holds the offsets and lengths of the
+ * term and of its postings. The terms and the postings follow the table.
+ * Postings are the differences between the times of the logs, each stored
+ * in seven bit groups with the high bit set on all but the last group.
+ * Logs that are appended later are stored behind that as their time, the
+ * length of the note and the note.
+ */
+
+// The file starts with this, followed by the time of the last entry seen,
+// the number of terms, the end of the postings and the end of the file.
+const char SEARCHMAGIC[8] = {'J','L','S','R','C','H','0','1'};
+const size_t SEARCHHEADERSIZE = 40;
+const size_t SEARCHRECORDSIZE = 24;
+const size_t SEARCHLOGHEADERSIZE = 12;
+// Appended logs are merged into the table when they take more than this
+// and more than a quarter of the table.
+const size_t SEARCHAPPENDLIMIT = 1 << 16;
+
+struct SearchRecord {
+    uint64_t termOffset;
+    uint64_t postingsOffset;
+    uint32_t termLength;
+    uint32_t postingsLength;
+};
+
+static_assert(sizeof(SearchRecord) == SEARCHRECORDSIZE,
+              "Unexpected search record size");
+
+/* Split a note into the terms that are indexed. Letters and digits form
+ * the terms, ASCII letters are turned into lower case. Bytes of other UTF-8
+ * characters are kept, so words with them are terms too. */
+void splitTerms(std::string_view text, vector<string>& out) {
+    string term;
+    for (char c : text) {
+        unsigned char u = c;
+        if ((u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || u >= 0x80) {
+            term += c;
+        }
+        else if (u >= 'A' && u <= 'Z') {
+            term += (char) (u - 'A' + 'a');
+        }
+        else if (! term.empty()) {
+            out.push_back(term);
+            term.clear();
+        }
+    }
+    if (! term.empty())
+        out.push_back(term);
+}
+
+void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+/* Read a number written by putVarint. Returns false at the end of the
+ * data. */
+bool getVarint(const char *& pos, const char *end, uint64_t& value) {
+    value = 0;
+    for (int shift=0; pos < end && shift < 64; shift+=7) {
+        unsigned char c = *pos++;
+        value |= (uint64_t) (c & 0x7f) << shift;
+        if (c < 0x80)
+            return true;
+    }
+    return false;
+}
+
+/* Decode postings and add them to the given times. */
+void decodePostings(const char *pos, const char *end, vector<int64_t>& out) {
+    uint64_t value = 0;
+    uint64_t delta;
+    while (getVarint(pos, end, delta)) {
+        value += delta;
+        out.push_back((int64_t) value);
+    }
+}
+
+SearchIndex::SearchIndex() {
+    this->through = INT64_MIN;
+    this->terms = 0;
+    this->tableEnd = SEARCHHEADERSIZE;
+    this->end = SEARCHHEADERSIZE;
+}
+
+void SearchIndex::setFile(const string& filename) {
+    this->filename = filename;
+}
+
+/* Map the index file. Returns false if there is none or it is broken. */
+bool SearchIndex::read() {
+    this->mapping.unmap();
+    int fd = open(this->filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    try {
+        this->mapping.map(fd);
+    } catch (CorruptedFileException& ex) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+    const char *data = this->mapping.getData();
+    size_t size = this->mapping.getSize();
+    if (size < SEARCHHEADERSIZE || memcmp(data, SEARCHMAGIC, 8) != 0)
+        return false;
+    memcpy(&this->through, data + 8, 8);
+    memcpy(&this->terms, data + 16, 8);
+    memcpy(&this->tableEnd, data + 24, 8);
+    memcpy(&this->end, data + 32, 8);
+    return this->terms <= (size - SEARCHHEADERSIZE) / SEARCHRECORDSIZE &&
+           SEARCHHEADERSIZE + this->terms * SEARCHRECORDSIZE <= this->tableEnd
+           && this->tableEnd <= this->end && this->end <= size;
+}
+
+int64_t SearchIndex::getThrough() {
+    return this->through;
+}
+
+/* The term of a record of the table. */
+std::string_view SearchIndex::termAt(uint64_t i) {
+    SearchRecord record;
+    memcpy(&record, this->mapping.getData() + SEARCHHEADERSIZE +
+                    i * SEARCHRECORDSIZE, SEARCHRECORDSIZE);
+    if (record.termOffset + record.termLength > this->tableEnd)
+        return std::string_view();
+    return std::string_view(this->mapping.getData() + record.termOffset,
+                            record.termLength);
+}
+
+/* Add the postings of a term in the table by a binary search. */
+void SearchIndex::findInTable(const string& term, vector<int64_t>& out) {
+    uint64_t low = 0;
+    uint64_t high = this->terms;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (this->termAt(middle) < term)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    if (low == this->terms || this->termAt(low) != term)
+        return;
+    SearchRecord record;
+    memcpy(&record, this->mapping.getData() + SEARCHHEADERSIZE +
+                    low * SEARCHRECORDSIZE, SEARCHRECORDSIZE);
+    if (record.postingsOffset + record.postingsLength > this->tableEnd)
+        return;
+    const char *pos = this->mapping.getData() + record.postingsOffset;
+    decodePostings(pos, pos + record.postingsLength, out);
+}
+
+/* The times of the logs that hold the term, sorted and each once. The
+ * appended logs are split into terms again. */
+vector<int64_t> SearchIndex::find(const string& term) {
+    vector<int64_t> res;
+    this->findInTable(term, res);
+    const char *data = this->mapping.getData();
+    uint64_t pos = this->tableEnd;
+    vector<string> noteTerms;
+    while (pos + SEARCHLOGHEADERSIZE <= this->end) {
+        int64_t time;
+        uint32_t length;
+        memcpy(&time, data + pos, 8);
+        memcpy(&length, data + pos + 8, 4);
+        pos += SEARCHLOGHEADERSIZE;
+        if (pos + length > this->end)
+            break;
+        noteTerms.clear();
+        splitTerms(std::string_view(data + pos, length), noteTerms);
+        if (std::find(noteTerms.begin(), noteTerms.end(), term) !=
+                    noteTerms.end() && (res.empty() || res.back() != time))
+            res.push_back(time);
+        pos += length;
+    }
+    // A log appended in the second of the last indexed one
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+}
+
+/* Read all postings of the table and the appended logs. */
+void SearchIndex::collect(Postings& out) {
+    const char *data = this->mapping.getData();
+    for (uint64_t i=0; i<this->terms; i++) {
+        SearchRecord record;
+        memcpy(&record, data + SEARCHHEADERSIZE + i * SEARCHRECORDSIZE,
+               SEARCHRECORDSIZE);
+        if (record.postingsOffset + record.postingsLength > this->tableEnd)
+            continue;
+        vector<int64_t>& times = out[string(this->termAt(i))];
+        const char *pos = data + record.postingsOffset;
+        decodePostings(pos, pos + record.postingsLength, times);
+    }
+    uint64_t pos = this->tableEnd;
+    vector<string> noteTerms;
+    while (pos + SEARCHLOGHEADERSIZE <= this->end) {
+        int64_t time;
+        uint32_t length;
+        memcpy(&time, data + pos, 8);
+        memcpy(&length, data + pos + 8, 4);
+        pos += SEARCHLOGHEADERSIZE;
+        if (pos + length > this->end)
+            break;
+        noteTerms.clear();
+        splitTerms(std::string_view(data + pos, length), noteTerms);
+        for (const string& term : noteTerms) {
+            vector<int64_t>& times = out[term];
+            if (times.empty() || times.back() != time)
+                times.push_back(time);
+        }
+        pos += length;
+    }
+}
+
+/* Merge the appended logs into the table. */
+void SearchIndex::compact() {
+    Postings postings;
+    this->collect(postings);
+    SearchIndex::write(this->filename, postings, this->through);
+}
+
+/* Append logs to the file, the last entry seen is at the given time. The
+ * logs are written first and the header last, so the file stays valid if
+ * this is interrupted. */
+void SearchIndex::append(const vector<int64_t>& times,
+                         const vector<std::string_view>& notes,
+                         int64_t through) {
+    string logs;
+    for (size_t i=0; i<times.size(); i++) {
+        uint32_t length = notes[i].size();
+        logs.append((const char *) &times[i], 8);
+        logs.append((const char *) &length, 4);
+        logs.append(notes[i]);
+    }
+    int fd = open(this->filename.c_str(), O_RDWR);
+    if (fd < 0)
+        return;
+    uint64_t end = this->end + logs.size();
+    string header(SEARCHMAGIC, 8);
+    header.append((const char *) &through, 8);
+    header.append((const char *) &this->terms, 8);
+    header.append((const char *) &this->tableEnd, 8);
+    header.append((const char *) &end, 8);
+    try {
+        writeAll(fd, logs, this->end);
+        if (ftruncate(fd, end) == 0) {
+            writeAll(fd, header, 0);
+            this->through = through;
+            this->end = end;
+        }
+    } catch (CorruptedFileException& ex) {
+        // The index is rebuilt when it is needed.
+    }
+    close(fd);
+    uint64_t appended = this->end - this->tableEnd;
+    if (appended > SEARCHAPPENDLIMIT && appended > this->tableEnd / 4 &&
+                this->read()) {
+        this->compact();
+    }
+}
+
+/* Write a new index file with the given postings. The times of each term
+ * have to be sorted. The file is replaced as a whole, so readers see either
+ * the old or the new one. */
+void SearchIndex::write(const string& filename, Postings& postings,
+                        int64_t through) {
+    vector<const string *> sorted;
+    sorted.reserve(postings.size());
+    for (auto& term : postings) {
+        sorted.push_back(&term.first);
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const string *a, const string *b) { return *a < *b; });
+    uint64_t terms = sorted.size();
+    uint64_t termsBegin = SEARCHHEADERSIZE + terms * SEARCHRECORDSIZE;
+    string table;
+    string termBytes;
+    string postingBytes;
+    vector<SearchRecord> records(terms);
+    for (uint64_t i=0; i<terms; i++) {
+        const vector<int64_t>& times = postings[*sorted[i]];
+        records[i].termOffset = termBytes.size();
+        records[i].termLength = sorted[i]->size();
+        termBytes += *sorted[i];
+        size_t before = postingBytes.size();
+        uint64_t last = 0;
+        for (int64_t time : times) {
+            putVarint(postingBytes, (uint64_t) time - last);
+            last = time;
+        }
+        records[i].postingsOffset = before;
+        records[i].postingsLength = postingBytes.size() - before;
+    }
+    uint64_t postingsBegin = termsBegin + termBytes.size();
+    uint64_t tableEnd = postingsBegin + postingBytes.size();
+    for (SearchRecord& record : records) {
+        record.termOffset += termsBegin;
+        record.postingsOffset += postingsBegin;
+    }
+    string out(SEARCHMAGIC, 8);
+    out.append((const char *) &through, 8);
+    out.append((const char *) &terms, 8);
+    out.append((const char *) &tableEnd, 8);
+    out.append((const char *) &tableEnd, 8);
+    out.append((const char *) records.data(), terms * SEARCHRECORDSIZE);
+    out += termBytes;
+    out += postingBytes;
+    // Readers that rebuild the index at the same time use their own file.
+    string temporary = filename + ".tmp" + std::to_string(getpid());
+    try {
+        writeFile(temporary, out);
+    } catch (CorruptedFileException& ex) {
+        unlink(temporary.c_str());
+        return;
+    }
+    if (rename(temporary.c_str(), filename.c_str()) != 0)
+        unlink(temporary.c_str());
+}
+
+/* The time of the last entry in seconds, the search index has to have seen
+ * it. */
+int64_t LogList::lastTime() {
+    if (this->entries.size() == 0)
+        return INT64_MIN;
+    return dt::to_time_t(this->entries.times.back());
+}
+
+/* Read the search index and tell whether it knows all logs. Like the
+ * rollups, only the last entry is compared. */
+bool LogList::prepareSearchIndex() {
+    return this->searchIndex.read() &&
+           this->searchIndex.getThrough() == this->lastTime();
+}
+
+/* Index all logs again. */
+void LogList::rebuildSearchIndex() {
+    this->loadAll();
+    Postings postings;
+    vector<string> terms;
+    for (size_t i=0; i<this->entries.size(); i++) {
+        if (this->entries.types[i] != LogEntryType::log)
+            continue;
+        int64_t time = dt::to_time_t(this->entries.times[i]);
+        terms.clear();
+        splitTerms(this->getEntry(i).viewNote(), terms);
+        for (const string& term : terms) {
+            vector<int64_t>& times = postings[term];
+            if (times.empty() || times.back() != time)
+                times.push_back(time);
+        }
+    }
+    SearchIndex::write(this->path + "/search", postings, this->lastTime());
+    this->searchIndex.read();
+}
+
+/* Add the logs that were written since the logs were read. If there is no
+ * search index, it is built when it is needed. An index that did not know
+ * the entries before is left alone, it is rebuilt when it is used. */
+void LogList::updateSearchIndex() {
+    size_t size = this->entries.size();
+    size_t first = std::min(this->amended, size - this->needsToBeWritten);
+    if (first >= size || ! this->searchIndex.read())
+        return;
+    // A replaced entry is the last one, its old time is not known anymore.
+    if (first > 0 && first != this->amended &&
+                this->searchIndex.getThrough() !=
+                dt::to_time_t(this->entries.times[first - 1]))
+        return;
+    vector<int64_t> times;
+    vector<std::string_view> notes;
+    for (size_t i=first; i<size; i++) {
+        if (this->entries.types[i] != LogEntryType::log)
+            continue;
+        times.push_back(dt::to_time_t(this->entries.times[i]));
+        notes.push_back(this->getEntry(i).viewNote());
+    }
+    this->searchIndex.append(times, notes, this->lastTime());
+}
+
+/* Get the entries between the given times, both included. */
+void LogList::entriesBetween(const dt::time_point& from,
+                             const dt::time_point& to,
+                             vector<LogEntry>& out) {
+    out.clear();
+    if (this->isComplete()) {
+        const vector<dt::time_point>& times = this->entries.times;
+        size_t i = std::lower_bound(times.begin(), times.end(), from) -
+                   times.begin();
+        for (; i<times.size() && times[i] <= to; i++) {
+            out.push_back(this->getEntry(i));
+        }
+        return;
+    }
+    dt::time_point after = from - dt::seconds(1);
+    dt::time_point before = to + dt::seconds(1);
+    bool includeLogs = true;
+    this->scan(after, before, includeLogs, [&out](LogEntry& entry) {
+        out.push_back(entry);
+    });
+}
+
+/* Get the entries of the session with the first log at the given time.
+ * Only the entries around it are read, more of them while the session
+ * reaches further. Nothing is given if the log is not in a session. */
+void LogList::sessionAround(int64_t time, vector<LogEntry>& out) {
+    out.clear();
+    dt::time_point at = dt::clock::from_time_t(time);
+    dt::time_point earliest = this->isComplete() ?
+            this->entries.times.front() : this->segments.front().first;
+    dt::time_point latest = this->entries.times.back();
+    vector<LogEntry> near;
+    for (dt::duration window = dt::hours(24); ; window *= 2) {
+        dt::time_point from = at - window;
+        dt::time_point to = at + window;
+        this->entriesBetween(from, to, near);
+        size_t log = 0;
+        while (log < near.size() &&
+                    (near[log].type() != LogEntryType::log ||
+                     dt::to_time_t(near[log].getTime()) != time))
+            log++;
+        if (log == near.size())
+            return;
+        size_t start = log;
+        while (start > 0 && near[start].type() == LogEntryType::log)
+            start--;
+        size_t end = log;
+        while (end < near.size() && near[end].type() == LogEntryType::log)
+            end++;
+        bool startFound = near[start].type() == LogEntryType::start;
+        bool endFound = end < near.size();
+        if ((startFound || from <= earliest) && (endFound || to >= latest)) {
+            if (! startFound || (endFound &&
+                                 near[end].type() != LogEntryType::end))
+                return;
+            out.assign(near.begin() + start,
+                       endFound ? near.begin() + end + 1 : near.end());
+            return;
+        }
+    }
+}
+
+/* Find the logs that hold all of the terms, grouped by their sessions. The
+ * search index is built first if it is missing or outdated. */
+vector<SearchHit> LogList::search(const vector<string>& terms) {
+    ProfileScope scope(Phase::query);
+    vector<SearchHit> res;
+    if (terms.empty() || this->entries.size() == 0)
+        return res;
+    if (! this->prepareSearchIndex())
+        this->rebuildSearchIndex();
+    vector<int64_t> times = this->searchIndex.find(terms[0]);
+    for (size_t i=1; i<terms.size() && ! times.empty(); i++) {
+        vector<int64_t> more = this->searchIndex.find(terms[i]);
+        vector<int64_t> both;
+        std::set_intersection(times.begin(), times.end(), more.begin(),
+                              more.end(), std::back_inserter(both));
+        times.swap(both);
+    }
+    vector<LogEntry> session;
+    vector<string> noteTerms;
+    size_t next = 0;
+    while (next < times.size()) {
+        this->sessionAround(times[next], session);
+        if (session.empty()) {
+            next++;
+            continue;
+        }
+        bool ended = session.back().type() == LogEntryType::end;
+        SearchHit hit{session.front(), ended ? session.back() : session.front(),
+                      ended, vector<LogEntry>()};
+        // Several logs can share a time, each one has to hold all terms.
+        for (LogEntry& entry : session) {
+            if (entry.type() != LogEntryType::log || ! std::binary_search(
+                        times.begin(), times.end(),
+                        (int64_t) dt::to_time_t(entry.getTime())))
+                continue;
+            noteTerms.clear();
+            splitTerms(entry.viewNote(), noteTerms);
+            bool all = true;
+            for (const string& term : terms) {
+                all = all && std::find(noteTerms.begin(), noteTerms.end(),
+                                       term) != noteTerms.end();
+            }
+            if (all)
+                hit.logs.push_back(entry);
+        }
+        int64_t last = ended ? dt::to_time_t(hit.end.getTime()) : INT64_MAX;
+        while (next < times.size() && times[next] <= last)
+            next++;
+        if (! hit.logs.empty())
+            res.push_back(hit);
+    }
+    return res;
+}
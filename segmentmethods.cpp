@@ -0,0 +1,281 @@
+/* Methods for the segments of the text format
+ *
+ * The text logs are split into files named 'logs.YYYY-MM' after the month
+ * they were begun in. A new segment is only begun with a start, so a
+ * session never spans two segments. The file 'manifest' lists the segments
+ * in order with one line each:
+ *   <name> <first time> <last time> <active|inactive>
+ * The times and the state are only kept up to date for the segments before
+ * the newest one, which are not changed anymore.
+ */
+
+/* Get the name of a segment begun at the given time. */
+string segmentName(const dt::time_point& time) {
+    char buff[16];
+    std::tm tm = dt::to_tm(time);
+    std::strftime(buff, 16, "logs.%Y-%m", &tm);
+    return string(buff);
+}
+
+/* Get a name for a new segment begun at the given time that is not used by
+ * the given segments yet. */
+string newSegmentName(const vector<Segment>& segments,
+                      const dt::time_point& time) {
+    string name = segmentName(time);
+    string res = name;
+    for (int i=1; ; i++) {
+        bool used = false;
+        for (const Segment& segment : segments) {
+            used = used || segment.name.compare(res) == 0;
+        }
+        if (! used)
+            return res;
+        res = name + "." + std::to_string(i);
+    }
+}
+
+/* Read the list of segments. */
+vector<Segment> readManifest(const string& path) {
+    std::ifstream file(path + "/manifest");
+    if (! file.good()) {
+        throw CorruptedFileException("Could not open the manifest");
+    }
+    vector<Segment> res;
+    string line;
+    while (std::getline(file, line) && !line.empty()) {
+        string::size_type space = line.find(' ');
+        if (space == string::npos ||
+                    line.size() < space + 2 * (dt::DATESIZE + 1) + 7) {
+            throw CorruptedFileException("Broken manifest line "+line);
+        }
+        Segment segment;
+        segment.name = line.substr(0, space);
+        string state = line.substr(space + 2 * (dt::DATESIZE + 1) + 1);
+        try {
+            segment.first = dt::parseDateStr(
+                    std::string_view(line).substr(space + 1, dt::DATESIZE));
+            segment.last = dt::parseDateStr(std::string_view(line).substr(
+                    space + dt::DATESIZE + 2, dt::DATESIZE));
+        } catch (dt::DateFormatException& ex) {
+            throw CorruptedFileException("Broken manifest line "+line);
+        }
+        if (state.compare("active") == 0) {
+            segment.active = true;
+        }
+        else if (state.compare("inactive") == 0) {
+            segment.active = false;
+        }
+        else {
+            throw CorruptedFileException("Broken manifest line "+line);
+        }
+        res.push_back(segment);
+    }
+    return res;
+}
+
+/* Replace the list of segments. */
+void writeManifest(const string& path, const vector<Segment>& segments) {
+    string out;
+    for (const Segment& segment : segments) {
+        out += segment.name + " " + dt::toString(segment.first) + " " +
+               dt::toString(segment.last) + " " +
+               (segment.active ? "active" : "inactive") + "\n";
+    }
+    writeFile(path + "/manifest.tmp", out);
+    if (rename((path + "/manifest.tmp").c_str(),
+               (path + "/manifest").c_str()) != 0) {
+        throw CorruptedFileException("Could not write the manifest");
+    }
+}
+
+/* Split logs in the text format into segments and write them with their
+ * manifest. Lines are copied as they are, only the date of the first and
+ * the last line of each segment is parsed. */
+void writeSegments(const string& path, const char *data, size_t size) {
+    vector<Segment> segments;
+    size_t segmentBegin = 0;
+    // Month and year of the current segment, as 'mm.YYYY'
+    std::string_view month;
+    size_t pos = 0;
+    
+    // Close the segment that ends at the given offset.
+    auto finish = [&](size_t segmentEnd) {
+        if (segmentEnd == segmentBegin)
+            return;
+        size_t lastBegin = segmentEnd - 1;
+        while (lastBegin > segmentBegin && data[lastBegin - 1] != '\n')
+            lastBegin--;
+        Segment segment;
+        try {
+            segment.first = dt::parseDateStr(
+                    std::string_view(data + segmentBegin, dt::DATESIZE));
+            segment.last = dt::parseDateStr(
+                    std::string_view(data + lastBegin, dt::DATESIZE));
+        } catch (dt::DateFormatException& ex) {
+            throw CorruptedFileException("Could not parse date "
+                    +string(data + lastBegin, dt::DATESIZE));
+        }
+        segment.name = newSegmentName(segments, segment.first);
+        // The state is that after the last start or end.
+        segment.active = false;
+        for (size_t line = segmentEnd; line > segmentBegin; ) {
+            size_t lineEnd = line - 1;
+            line = lineEnd;
+            while (line > segmentBegin && data[line - 1] != '\n')
+                line--;
+            std::string_view content(data + line, lineEnd - line);
+            if (content.size() < dt::DATESIZE + 1)
+                continue;
+            content.remove_prefix(dt::DATESIZE + 1);
+            if (content.compare("start") == 0 || content.compare("end") == 0) {
+                segment.active = content.compare("start") == 0;
+                break;
+            }
+        }
+        writeFile(path + "/" + segment.name,
+                  string(data + segmentBegin, segmentEnd - segmentBegin));
+        segments.push_back(segment);
+        segmentBegin = segmentEnd;
+    };
+    
+    while (pos < size) {
+        const char *lineEnd = (const char *) memchr(data + pos, '\n',
+                                                    size - pos);
+        size_t next = lineEnd ? lineEnd - data + 1 : size;
+        std::string_view line(data + pos, next - pos);
+        if (line.size() < dt::DATESIZE + 6) {
+            // Broken lines are copied, the parser complains about them.
+        }
+        else if (month.empty()) {
+            month = line.substr(3, 7);
+        }
+        else if (line.compare(dt::DATESIZE + 1, 5, "start") == 0 &&
+                    line.compare(3, 7, month) != 0) {
+            finish(pos);
+            month = line.substr(3, 7);
+        }
+        pos = next;
+    }
+    finish(size);
+    writeManifest(path, segments);
+}
+
+/* Tell whether the logs in the given directory are still in a single file
+ * and are split into segments when they are opened. */
+bool LogList::needsSplitting(const string& path) {
+    return access((path + "/manifest").c_str(), F_OK) != 0 &&
+           access((path + "/logs.bin").c_str(), F_OK) != 0 &&
+           access((path + "/logs").c_str(), F_OK) == 0;
+}
+
+/* Read the manifest and open the newest segment. Logs in a single file are
+ * split into segments first, which rewrites files that others might have
+ * mapped. The caller has to hold the lock alone then. */
+void LogList::openSegments() {
+    if (access((this->path + "/manifest").c_str(), F_OK) != 0) {
+        int single = open((this->path + "/logs").c_str(), O_RDONLY);
+        if (single < 0)
+            throw CorruptedFileException("Could not open a logs file");
+        MappedFile mapping;
+        try {
+            mapping.map(single);
+        } catch (CorruptedFileException& ex) {
+            close(single);
+            throw;
+        }
+        close(single);
+        writeSegments(this->path, mapping.getData(), mapping.getSize());
+        // Once the manifest exists, the old file is not used anymore.
+        unlink((this->path + "/logs").c_str());
+        unlink((this->path + "/logs.idx").c_str());
+    }
+    this->segments = readManifest(this->path);
+    this->segmentMappings.assign(this->segments.size(), nullptr);
+    this->segmentBases.assign(this->segments.size(), 0);
+    if (! this->segments.empty()) {
+        const string& name = this->segments.back().name;
+        this->fd = open((this->path + "/" + name).c_str(),
+                        O_RDWR | O_APPEND);
+        if (this->fd < 0)
+            throw CorruptedFileException("Could not open "+name);
+        this->index.setFile(this->path + "/" + name + ".idx");
+    }
+}
+
+/* Get the mapping of a segment, mapping it if that was not done yet. */
+MappedFile *LogList::mapSegment(size_t i) {
+    if (this->segmentMappings[i])
+        return this->segmentMappings[i];
+    ProfileScope scope(Phase::read);
+    bool newest = i == this->segments.size() - 1;
+    int fd = newest ? this->fd : open((this->path + "/" +
+                                  this->segments[i].name).c_str(), O_RDONLY);
+    if (fd < 0)
+        throw CorruptedFileException("Could not open "+this->segments[i].name);
+    MappedFile *mapping = new MappedFile();
+    try {
+        mapping->map(fd);
+    } catch (CorruptedFileException& ex) {
+        delete mapping;
+        if (! newest)
+            close(fd);
+        throw;
+    }
+    if (! newest)
+        close(fd);
+    this->segmentMappings[i] = mapping;
+    this->segmentBases[i] = this->notes.addExternal(mapping->getData(),
+                                                    mapping->getSize());
+    return mapping;
+}
+
+/* Tell whether a start at the given time begins a new segment. */
+bool LogList::needsNewSegment(const dt::time_point& time) {
+    if (this->segments.empty())
+        return true;
+    string name = segmentName(time);
+    return this->segments.back().name.compare(0, name.size(), name) != 0;
+}
+
+/* Close the newest segment and begin a new one with the entry at the given
+ * position. */
+void LogList::addSegment(size_t pos) {
+    Segment segment;
+    segment.first = this->entries.times[pos];
+    segment.last = segment.first;
+    segment.active = false;
+    segment.name = newSegmentName(this->segments, segment.first);
+    if (! this->segments.empty()) {
+        Segment& old = this->segments.back();
+        if (pos > this->firstEntry)
+            old.last = this->entries.times[pos - 1];
+        // A start follows, so the segment ends inactive.
+        old.active = false;
+    }
+    int fd = open((this->path + "/" + segment.name).c_str(),
+                  O_RDWR | O_APPEND | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw CorruptedFileException("Could not create "+segment.name);
+    if (this->fd >= 0)
+        close(this->fd);
+    this->fd = fd;
+    this->segments.push_back(segment);
+    this->segmentMappings.push_back(nullptr);
+    this->segmentBases.push_back(0);
+    this->index.setFile(this->path + "/" + segment.name + ".idx");
+    unlink((this->path + "/" + segment.name + ".idx").c_str());
+    this->begin = 0;
+    this->firstEntry = pos;
+    writeManifest(this->path, this->segments);
+}
+
+/* Remove all files of the text format. */
+void removeSegments(const string& path) {
+    vector<Segment> segments = readManifest(path);
+    // Once the manifest is gone, the segments are not used anymore.
+    unlink((path + "/manifest").c_str());
+    for (const Segment& segment : segments) {
+        unlink((path + "/" + segment.name).c_str());
+        unlink((path + "/" + segment.name + ".idx").c_str());
+    }
+}
@@ -14,9 +14,24 @@ const string HELPMSG(
   "  log     Write down what you did.\n"
   "  state   Give a short overview of the current state.\n"
   "  list    List what was done.\n"
+  "  search  Find the logs that mention something.\n"
+  "  report  Sum up the time worked per day, week or month.\n"
+  "  batch   Apply many commands at once.\n"
+  "  import  Add entries from other trackers.\n"
+  "  convert Change the format the logs are stored in.\n"
   "\n"
   "Use 'joblog help <topic>' to get further help on a topic.\n"
-  "Available topics are: start, end, list, args"
+  "Available topics are: init, start, end, list, search, report, batch,\n"
+  "import, convert, args"
+);
+
+const string HELPMSG_INIT(
+    "joblog init [-b]\n"
+    "\n"
+    "Create the directory '.joblog' with an empty logfile.\n"
+    "Arguments:\n"
+    " -b  Store the logs in the binary format, which is faster to load but\n"
+    "     can not be edited by hand.\n"
 );
 
 const string HELPMSG_START(
@@ -38,7 +53,8 @@ const string HELPMSG_END(
 );
 
 const string HELPMSG_LIST(
-  "joblog list [-s] [<specifier>]\n"
+  "joblog list [-s|-t] [<specifier>]\n"
+  "joblog list --recursive <directory> [<specifier>]\n"
   "\n"
   "List the recent work. The time specifier can be:\n"
   " 1) Empty. Work of this day will be listed.\n"
@@ -56,20 +72,95 @@ const string HELPMSG_LIST(
   "    'dd.mm.yyyy - dd.mm.yyyy'. Work between these days will be listed.\n"
   "\n"
   "Arguments:\n"
-  " -s  Do not list log notes."
+  " -s  Do not list log notes.\n"
+  " -t  Only print the time worked in total. Sessions that reach over the\n"
+  "     edges of the range are only counted within it.\n"
+  " --recursive  Find all logs below the directory and print the time\n"
+  "     worked in total for each of them and overall, as with -t."
+);
+
+const string HELPMSG_SEARCH(
+  "joblog search <terms>\n"
+  "\n"
+  "List the logs that hold all of the terms, with the sessions they were\n"
+  "written in. Terms are words and numbers, case does not matter for ASCII\n"
+  "letters. The logs are found through an index in the file 'search',\n"
+  "which is built on the first search and kept up to date from then on."
+);
+
+const string HELPMSG_REPORT(
+  "joblog report [-d|-w|-m] [--csv] [--target=<hours>] [<specifier>]\n"
+  "\n"
+  "Sum up the time worked per day, week or month in the range given by the\n"
+  "time specifier of list. Without one, the current month is reported.\n"
+  "For each of them, the days worked, the average time per day worked and\n"
+  "the overtime are printed. The overtime is the time worked beyond the\n"
+  "target for each day from Monday to Friday.\n"
+  "Arguments:\n"
+  " -d                Report per day. This is the default.\n"
+  " -w                Report per week. Weeks begin on Monday and are\n"
+  "                   numbered as in ISO 8601.\n"
+  " -m                Report per month.\n"
+  " --csv             Print comma separated values with times in hours.\n"
+  " --target=<hours>  Hours to work per day (default 8)."
+);
+
+const string HELPMSG_BATCH(
+  "joblog batch [<file>]\n"
+  "\n"
+  "Read commands from the file, or from stdin if none is given, one per\n"
+  "line, and write the logs once in the end. A line is one of\n"
+  "  [<time>] start [-a]\n"
+  "  [<time>] end [-a]\n"
+  "  [<time>] log <note>\n"
+  "where the time has the form 'dd.mm.yyyy hh:mm:ss'. Without it, the\n"
+  "current time is used. Times may not go back before the last entry.\n"
+  "Empty lines and lines starting with '#' are skipped. If a command fails,\n"
+  "nothing is written."
+);
+
+const string HELPMSG_IMPORT(
+  "joblog import <file>\n"
+  "\n"
+  "Add entries from a CSV or JSON lines file to the logs, wherever they\n"
+  "belong in time. Use '-' to read from stdin.\n"
+  "  CSV         Lines of 'time,type,note'. Fields may be quoted.\n"
+  "  JSON lines  One object per line with the members \"time\", \"type\"\n"
+  "              and \"note\".\n"
+  "Files ending with '.jsonl', '.ndjson' or '.json' and input starting with\n"
+  "'{' are read as JSON lines, everything else as CSV.\n"
+  "The type is start, end or log. Times are local and have the form\n"
+  "'dd.mm.yyyy hh:mm:ss' or 'yyyy-mm-dd hh:mm:ss'. The sessions of the\n"
+  "merged logs are checked, and nothing is changed if they do not fit."
+);
+
+const string HELPMSG_CONVERT(
+  "joblog convert <format>\n"
+  "\n"
+  "Store the logs in the given format from now on. The format can be:\n"
+  "  text    Files 'logs.YYYY-MM' with one line per entry.\n"
+  "  binary  The files 'logs.bin' and 'logs.notes'. They are faster to load\n"
+  "          but can not be edited by hand."
 );
 
 const string HELPMSG_ARGS(
     "Available arguments are:\n"
     " -path=<path>   Specify to use a given path instead of searching for\n"
     "                  default path. Do not end with '/'.\n"
-    " -c             Check the integrity of the files used while progressing."
+    " -c             Check the integrity of the files used while progressing.\n"
+    "                  Only what changed since the last check is read.\n"
+    " --profile      Print where the time went and how much was read,\n"
+    "                  written and allocated to stderr."
 );
 
-/* Try to get the LogList. If an error occours, handle it. */
-bool getLoglist(Joblog *joblog, LogList **out) {
+/* Try to get the LogList. If an error occours, handle it. If recentOnly is
+ * set, the LogList might only hold the current session. */
+bool getLoglist(Joblog *joblog, LogList **out, bool recentOnly) {
     try {
-        *out = joblog->getLogList();
+        if (recentOnly)
+            *out = joblog->getRecentLogList();
+        else
+            *out = joblog->getLogList();
     } catch (CorruptedFileException& ex) {
         std::cout << "The logfile is corrupted. Try to fix it manually.\n"
                      "The exeptions message is:\n"
@@ -79,26 +170,10 @@ bool getLoglist(Joblog *joblog, LogList **out) {
     return true;
 }
 
-/* Print information. */
-int list(LogList *loglist, vector<string> args) {
-    // default settings
-    bool listLogs=true;
-    dt::time_point from = dt::now();
-    dt::time_point to = dt::now();
-    
-    // parse arguments
-    while( args.size() > 0 && (args[0][0] == '-')) {
-        if (args[0].compare("-s") == 0) {
-            listLogs = false;
-        }
-        else {
-            std::cout << "Unkown option." << std::endl;
-            return 1;
-        }
-        args.erase(args.begin());
-    }
-    
-    // parse time specifier
+/* Read the time specifier of list into the range. 'from' and 'to' have to
+ * be set to now. Returns false if the specifier is unknown. */
+bool parseTimeSpecifier(vector<string> args, dt::time_point& from,
+                        dt::time_point& to) {
     bool success = false;
     if (args.size() == 0) {
         from = dt::getBeginOfDay(from);
@@ -138,38 +213,514 @@ int list(LogList *loglist, vector<string> args) {
             success = true;
         } catch(dt::DateFormatException& ex) {}
     }
-    if (! success) {
+    return success;
+}
+
+/* Print information. */
+int list(LogList *loglist, vector<string> args) {
+    // default settings
+    bool listLogs=true;
+    bool totalOnly=false;
+    dt::time_point from = dt::now();
+    dt::time_point to = dt::now();
+    
+    // parse arguments
+    while( args.size() > 0 && (args[0][0] == '-')) {
+        if (args[0].compare("-s") == 0) {
+            listLogs = false;
+        }
+        else if (args[0].compare("-t") == 0) {
+            totalOnly = true;
+        }
+        else {
+            std::cout << "Unkown option." << std::endl;
+            return 1;
+        }
+        args.erase(args.begin());
+    }
+    
+    if (! parseTimeSpecifier(args, from, to)) {
         std::cout << "Unkown date specifier. ";
         std::cout << "Use 'help list' for help." << std::endl;
         return 2;
     }
     
-    // print information
-    vector<LogEntry *> allentries = loglist->list(from, to, listLogs);
-    
-    dt::time_point last_start = to;
-    dt::duration workedtime = dt::seconds(0);
-    vector<LogEntryLog *> notes;
-    for (vector<LogEntry *>::iterator e = allentries.begin();
-           e != allentries.end(); ++e) {
-        if ((*e)->type() == LogEntryType::start) {
-            last_start = (*e)->getTime();
-        }
-        else if ((*e)->type() == LogEntryType::log) {
-            notes.push_back((LogEntryLog *) *e);
-        }
-        else if ((*e)->type() == LogEntryType::end) {
-            dt::duration thistime = (*e)->getTime() - last_start;
-            std::cout << dt::toDateString(last_start) << ": Worked ";
-            std::cout << dt::toString(thistime) << std::endl;
-            for (LogEntryLog *e : notes) {
-                std::cout << " - " << e->getNote() << std::endl;
+    // print information. Only the requested range is parsed here, so broken
+    // lines in it are only found now.
+    try {
+        if (totalOnly) {
+            dt::duration worked = loglist->workedTime(from, to);
+            std::cout << "Overall: " << dt::toString(worked) << std::endl;
+            return 0;
+        }
+        // Entries are printed while they are read. Only the notes of the
+        // current session are kept.
+        std::cout.flush();
+        OutputBuffer out(STDOUT_FILENO);
+        dt::time_point last_start = to;
+        dt::duration workedtime = dt::seconds(0);
+        vector<LogEntry> notes;
+        loglist->scan(from, to, listLogs, [&](LogEntry& e) {
+            ProfileScope scope(Phase::output);
+            if (e.type() == LogEntryType::start) {
+                last_start = e.getTime();
             }
-            workedtime += thistime;
-            notes.clear();
+            else if (e.type() == LogEntryType::log) {
+                notes.push_back(e);
+            }
+            else if (e.type() == LogEntryType::end) {
+                dt::duration thistime = e.getTime() - last_start;
+                out.putDay(last_start);
+                out.put(": Worked ");
+                out.putDuration(thistime);
+                out.put('\n');
+                for (LogEntry& note : notes) {
+                    out.put(" - ");
+                    out.put(note.viewNote());
+                    out.put('\n');
+                }
+                workedtime += thistime;
+                notes.clear();
+            }
+        });
+        out.put("\nOverall: ");
+        out.putDuration(workedtime);
+        out.put('\n');
+    } catch (CorruptedFileException& ex) {
+        std::cout << "The logfile is corrupted. Try to fix it manually.\n"
+                     "The exeptions message is:\n"
+                     "  '" << ex.what() << "'" << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
+/* Print the logs that hold all of the terms with their sessions. */
+int search(Joblog *joblog, vector<string> args) {
+    vector<string> terms;
+    for (const string& arg : args) {
+        splitTerms(arg, terms);
+    }
+    if (terms.empty()) {
+        std::cout << "Nothing to search for. Use 'help search' for help."
+                  << std::endl;
+        return 2;
+    }
+    LogList *loglist;
+    if (! getLoglist(joblog, &loglist, true)) return 2;
+    vector<SearchHit> hits;
+    try {
+        hits = loglist->search(terms);
+    } catch (CorruptedFileException& ex) {
+        std::cout << "The logfile is corrupted. Try to fix it manually.\n"
+                     "The exeptions message is:\n"
+                     "  '" << ex.what() << "'" << std::endl;
+        return 2;
+    }
+    if (hits.empty()) {
+        std::cout << "Nothing found." << std::endl;
+        return 1;
+    }
+    std::cout.flush();
+    OutputBuffer out(STDOUT_FILENO);
+    size_t logs = 0;
+    for (SearchHit& hit : hits) {
+        ProfileScope scope(Phase::output);
+        out.putDay(hit.start.getTime());
+        if (hit.ended) {
+            out.put(": Worked ");
+            out.putDuration(hit.end.getTime() - hit.start.getTime());
+        }
+        else {
+            out.put(": Working for ");
+            out.putDuration(dt::now() - hit.start.getTime());
         }
+        out.put('\n');
+        for (LogEntry& log : hit.logs) {
+            out.put(" - ");
+            out.put(log.viewNote());
+            out.put('\n');
+        }
+        logs += hit.logs.size();
     }
-    std::cout << "\nOverall: " << dt::toString(workedtime) << std::endl;
+    out.put("\nFound " + std::to_string(logs) + (logs == 1 ? " log" : " logs")
+            + " in " + std::to_string(hits.size()) +
+            (hits.size() == 1 ? " session.\n" : " sessions.\n"));
+    return 0;
+}
+
+/* Write seconds as a duration like '2h15min', with a minus if they are
+ * negative. */
+string signedDuration(int64_t seconds) {
+    char buff[dt::FORMATSIZE + 1];
+    char *out = buff;
+    if (seconds < 0)
+        *out++ = '-';
+    out = dt::formatDuration(out, dt::seconds(std::abs(seconds)));
+    return string(buff, out - buff);
+}
+
+/* Write a day as 'yyyy-mm-dd'. */
+string isoDate(long long day) {
+    long long y;
+    unsigned m, d;
+    dt::civilFromDays(day, y, m, d);
+    char buff[32];
+    snprintf(buff, sizeof(buff), "%04lld-%02u-%02u", y, m, d);
+    return buff;
+}
+
+/* Print the time worked per day, week or month. */
+int report(Joblog *joblog, vector<string> args) {
+    ReportUnit unit = ReportUnit::day;
+    bool csv = false;
+    int64_t target = 8 * 3600;
+    while (args.size() > 0 && args[0][0] == '-') {
+        if (args[0].compare("-d") == 0) {
+            unit = ReportUnit::day;
+        }
+        else if (args[0].compare("-w") == 0) {
+            unit = ReportUnit::week;
+        }
+        else if (args[0].compare("-m") == 0) {
+            unit = ReportUnit::month;
+        }
+        else if (args[0].compare("--csv") == 0) {
+            csv = true;
+        }
+        else if (args[0].compare(0, 9, "--target=") == 0) {
+            target = (int64_t) (atof(args[0].c_str() + 9) * 3600);
+        }
+        else {
+            std::cout << "Unkown option." << std::endl;
+            return 1;
+        }
+        args.erase(args.begin());
+    }
+    dt::time_point from = dt::now();
+    dt::time_point to = dt::now();
+    if (args.size() == 0) {
+        from = dt::getBeginOfDay(dt::getLastFirstOfMonth(from));
+    }
+    else if (! parseTimeSpecifier(args, from, to)) {
+        std::cout << "Unkown date specifier. ";
+        std::cout << "Use 'help report' for help." << std::endl;
+        return 2;
+    }
+    if (to <= from) {
+        std::cout << "The range is empty." << std::endl;
+        return 2;
+    }
+    LogList *loglist;
+    if (! getLoglist(joblog, &loglist, true)) return 2;
+
+    vector<int64_t> begins;
+    vector<int64_t> ends;
+    // Only the requested range is parsed here, so broken lines in it are
+    // only found now.
+    try {
+        loglist->sessionsIn(from, to, begins, ends);
+    } catch (CorruptedFileException& ex) {
+        std::cout << "The logfile is corrupted. Try to fix it manually.\n"
+                     "The exeptions message is:\n"
+                     "  '" << ex.what() << "'" << std::endl;
+        return 2;
+    }
+    // A range up to midnight does not include the next day.
+    Report sums(dt::toDayNumber(from),
+                  dt::toDayNumber(to - dt::seconds(1)));
+    sums.addSessions(begins, ends);
+    vector<ReportRow> rows = sums.rows(unit);
+
+    ProfileScope scope(Phase::output);
+    std::cout.flush();
+    OutputBuffer out(STDOUT_FILENO);
+    char line[256];
+    if (csv) {
+        out.put("period,first_day,last_day,worked_hours,days_worked,"
+                "average_hours,overtime_hours\n");
+    }
+    else {
+        snprintf(line, sizeof(line), "%-16s %10s %5s %10s %10s\n", "Period",
+                 "Worked", "Days", "Average", "Overtime");
+        out.put(line);
+    }
+    ReportRow total{0, 0, 0, 0, 0};
+    for (ReportRow& row : rows) {
+        int64_t average = row.daysWorked > 0 ? row.worked / row.daysWorked
+                                             : 0;
+        int64_t overtime = row.worked - target * row.workDays;
+        string label = Report::label(unit, row.firstDay);
+        if (csv) {
+            snprintf(line, sizeof(line), "%s,%s,%s,%.2f,%d,%.2f,%.2f\n",
+                     label.c_str(), isoDate(row.firstDay).c_str(),
+                     isoDate(row.lastDay).c_str(), row.worked / 3600.0,
+                     row.daysWorked, average / 3600.0, overtime / 3600.0);
+        }
+        else {
+            snprintf(line, sizeof(line), "%-16s %10s %5d %10s %10s\n",
+                     label.c_str(), signedDuration(row.worked).c_str(),
+                     row.daysWorked, signedDuration(average).c_str(),
+                     signedDuration(overtime).c_str());
+        }
+        out.put(line);
+        total.worked += row.worked;
+        total.daysWorked += row.daysWorked;
+        total.workDays += row.workDays;
+    }
+    if (! csv) {
+        int64_t average = total.daysWorked > 0 ?
+                total.worked / total.daysWorked : 0;
+        snprintf(line, sizeof(line), "\n%-16s %10s %5d %10s %10s\n",
+                 "Total", signedDuration(total.worked).c_str(),
+                 total.daysWorked, signedDuration(average).c_str(),
+                 signedDuration(total.worked - target * total.workDays)
+                 .c_str());
+        out.put(line);
+    }
+    return 0;
+}
+
+/* The time worked on one project of a recursive list. */
+struct ProjectTime {
+    string name;
+    dt::duration worked;
+    string error;
+};
+
+/* Sum up the time worked in every project below a directory. The projects
+ * are read in parallel, each with its own lock. */
+int listRecursive(vector<string> args) {
+    if (args.size() == 0) {
+        std::cout << "No directory given. Use 'help list' for help."
+                  << std::endl;
+        return 2;
+    }
+    string root = args[0];
+    while (root.size() > 1 && root.back() == '/')
+        root.pop_back();
+    args.erase(args.begin());
+    dt::time_point from = dt::now();
+    dt::time_point to = dt::now();
+    if (! parseTimeSpecifier(args, from, to)) {
+        std::cout << "Unkown date specifier. ";
+        std::cout << "Use 'help list' for help." << std::endl;
+        return 2;
+    }
+
+    vector<string> paths;
+    {
+        ProfileScope scope(Phase::search);
+        findLogDirs(root, paths);
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        std::cout << "No logs found in " << root << "." << std::endl;
+        return 2;
+    }
+    vector<ProjectTime> projects(paths.size());
+    std::atomic<size_t> next(0);
+    auto work = [&paths, &projects, &next, from, to]() {
+        size_t i;
+        while ((i = next++) < paths.size()) {
+            ProjectTime& project = projects[i];
+            // The directory holding the logs names the project.
+            project.name = paths[i].substr(0,
+                                     paths[i].size() - SAVEPATH.size() - 1);
+            project.worked = dt::seconds(0);
+            Joblog joblog;
+            joblog.setPath(paths[i]);
+            try {
+                dt::time_point begin = from;
+                dt::time_point end = to;
+                project.worked = joblog.getRecentLogList()
+                                       ->workedTime(begin, end);
+                joblog.save();
+            } catch (CustomException& ex) {
+                project.error = ex.what();
+            }
+        }
+    };
+    size_t threads = std::min(std::max(
+            (size_t) std::thread::hardware_concurrency(), (size_t) 1),
+            paths.size());
+    vector<std::thread> workers;
+    for (size_t i=1; i<threads; i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    int res = 0;
+    dt::duration overall = dt::seconds(0);
+    for (ProjectTime& project : projects) {
+        if (! project.error.empty()) {
+            std::cout << project.name << ": Could not be read. The exception "
+                         "message is:\n  '" << project.error << "'"
+                      << std::endl;
+            res = 2;
+            continue;
+        }
+        std::cout << project.name << ": " << dt::toString(project.worked)
+                  << std::endl;
+        overall += project.worked;
+    }
+    std::cout << "\nOverall: " << dt::toString(overall) << std::endl;
+    return res;
+}
+
+/* Apply a single line of a batch. A line is a command, optionally preceded
+ * by the time it happened at. */
+void applyBatchLine(LogList *loglist, std::string_view line) {
+    dt::time_point time;
+    if (line.size() >= (size_t) dt::DATESIZE &&
+                line[0] >= '0' && line[0] <= '9') {
+        try {
+            time = dt::parseDateStr(line.substr(0, dt::DATESIZE));
+        } catch (dt::DateFormatException& ex) {
+            throw SituationalMistake("Invalid date");
+        }
+        line.remove_prefix(dt::DATESIZE);
+        while (! line.empty() && line[0] == ' ')
+            line.remove_prefix(1);
+    }
+    else {
+        time = dt::now();
+    }
+    size_t space = line.find(' ');
+    std::string_view command = line.substr(0, space);
+    std::string_view rest;
+    if (space != std::string_view::npos)
+        rest = line.substr(space + 1);
+
+    if (command == "log") {
+        if (rest.empty())
+            throw SituationalMistake("Empty log");
+        loglist->log(string(rest), time);
+        return;
+    }
+    if (! rest.empty() && rest != "-a")
+        throw SituationalMistake("Unknown argument '"+string(rest)+"'");
+    if (command == "start")
+        loglist->start(! rest.empty(), time);
+    else if (command == "end")
+        loglist->end(! rest.empty(), time);
+    else
+        throw SituationalMistake("Unknown command '"+string(command)+"'");
+}
+
+/* Apply the commands read from a file or stdin, one per line. The logs are
+ * written once in the end, and not at all if one of the commands fails. */
+int batch(Joblog *joblog, vector<string> args) {
+    string input;
+    bool read;
+    if (args.empty() || args[0].compare("-") == 0) {
+        read = readAll(STDIN_FILENO, input);
+    }
+    else {
+        int fd = open(args[0].c_str(), O_RDONLY | O_CLOEXEC);
+        read = fd >= 0 && readAll(fd, input);
+        if (fd >= 0)
+            close(fd);
+    }
+    if (! read) {
+        std::cout << "Could not read the commands." << std::endl;
+        return 2;
+    }
+
+    LogList *loglist;
+    joblog->requestWriting();
+    if (! getLoglist(joblog, &loglist, true)) return 2;
+
+    size_t applied = 0;
+    size_t lineNumber = 0;
+    const char *pos = input.data();
+    const char *end = pos + input.size();
+    while (pos < end) {
+        const char *next = (const char *) memchr(pos, '\n', end - pos);
+        if (next == nullptr)
+            next = end;
+        std::string_view line(pos, next - pos);
+        pos = next + 1;
+        lineNumber++;
+        if (! line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        if (line.empty() || line[0] == '#')
+            continue;
+        try {
+            applyBatchLine(loglist, line);
+        } catch (SituationalMistake& ex) {
+            std::cout << "Line " << lineNumber << ": " << ex.what() << "\n"
+                         "Nothing was written." << std::endl;
+            joblog->unload();
+            return 2;
+        }
+        applied++;
+    }
+    std::cout << "Applied " << applied << " commands." << std::endl;
+    return 0;
+}
+
+/* Tell whether a file name ends with the given suffix. */
+bool endsWith(const string& name, const string& suffix) {
+    return name.size() >= suffix.size() &&
+           name.compare(name.size() - suffix.size(), suffix.size(),
+                        suffix) == 0;
+}
+
+/* Read entries from a file and merge them into the logs. */
+int import(Joblog *joblog, vector<string> args) {
+    if (args.size() != 1) {
+        std::cout << "Give one file to import. Use 'help import' for help."
+                  << std::endl;
+        return 2;
+    }
+    string input;
+    bool read;
+    if (args[0].compare("-") == 0) {
+        read = readAll(STDIN_FILENO, input);
+    }
+    else {
+        int fd = open(args[0].c_str(), O_RDONLY | O_CLOEXEC);
+        read = fd >= 0 && readAll(fd, input);
+        if (fd >= 0)
+            close(fd);
+    }
+    if (! read) {
+        std::cout << "Could not read " << args[0] << "." << std::endl;
+        return 2;
+    }
+    size_t first = input.find_first_not_of(" \t\r\n");
+    bool jsonl = endsWith(args[0], ".jsonl") || endsWith(args[0], ".ndjson")
+                 || endsWith(args[0], ".json") ||
+                 (first != string::npos && input[first] == '{');
+
+    StringPool notes;
+    vector<LogEntry> entries;
+    LogList *loglist;
+    try {
+        if (jsonl)
+            parseImportJsonl(input, notes, entries);
+        else
+            parseImportCsv(input, notes, entries);
+        joblog->requestWriting();
+        if (! getLoglist(joblog, &loglist, true)) return 2;
+        loglist->import(entries);
+    } catch (SituationalMistake& ex) {
+        std::cout << ex.what() << "\nNothing was imported." << std::endl;
+        joblog->unload();
+        return 2;
+    } catch (CorruptedFileException& ex) {
+        std::cout << "Importing failed. The exception message is:\n"
+                     "'" << ex.what() << "'" << std::endl;
+        joblog->unload();
+        return 2;
+    }
+    // The files were replaced, the loaded logs are outdated.
+    joblog->unload();
+    std::cout << "Imported " << entries.size() << " entries." << std::endl;
     return 0;
 }
 
@@ -181,6 +732,10 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
             return 0;
         }
         else {
+            if (args[1].compare("init") == 0) {
+                std::cout << HELPMSG_INIT << std::endl;
+                return 0;
+            }
             if (args[1].compare("start") == 0) {
                 std::cout << HELPMSG_START << std::endl;
                 return 0;
@@ -193,6 +748,26 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
                 std::cout << HELPMSG_LIST << std::endl;
                 return 0;
             }
+            if (args[1].compare("search") == 0) {
+                std::cout << HELPMSG_SEARCH << std::endl;
+                return 0;
+            }
+            if (args[1].compare("report") == 0) {
+                std::cout << HELPMSG_REPORT << std::endl;
+                return 0;
+            }
+            if (args[1].compare("batch") == 0) {
+                std::cout << HELPMSG_BATCH << std::endl;
+                return 0;
+            }
+            if (args[1].compare("import") == 0) {
+                std::cout << HELPMSG_IMPORT << std::endl;
+                return 0;
+            }
+            if (args[1].compare("convert") == 0) {
+                std::cout << HELPMSG_CONVERT << std::endl;
+                return 0;
+            }
             else if (args[1].compare("args") == 0) {
                 std::cout << HELPMSG_ARGS << std::endl;
                 return 0;
@@ -204,8 +779,11 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
         }
     }
     if (args[0].compare("init") == 0) {
+        LogFormat format = LogFormat::text;
+        if (args.size() > 1 && args[1].compare("-b") == 0)
+            format = LogFormat::binary;
         try {
-            int res = joblog->init();
+            int res = joblog->init(format);
             std::cout << "Initialized." << std::endl;
             return res;
         } catch (CorruptedFileException& ex) {
@@ -218,7 +796,8 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
     }
     if (args[0].compare("start") == 0) {
         LogList *loglist;
-        if (! getLoglist(joblog, &loglist)) return 2;
+        joblog->requestWriting();
+        if (! getLoglist(joblog, &loglist, true)) return 2;
         
         bool again = false;
         if (args.size() > 1 && args[1].compare("-a") == 0)
@@ -236,13 +815,14 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
             return 2;
         }
         std::cout << "Started at "
-                  << dt::toClockTimeStr(loglist->getLastEntry()->getTime())
+                  << dt::toClockTimeStr(loglist->getLastEntry().getTime())
                   << "." << std::endl;
         return 0;
     }
     if (args[0].compare("end") == 0) {
         LogList *loglist;
-        if (! getLoglist(joblog, &loglist)) return 2;
+        joblog->requestWriting();
+        if (! getLoglist(joblog, &loglist, true)) return 2;
         
         bool again = false;
         if (args.size() > 1 && args[1].compare("-a") == 0)
@@ -254,8 +834,8 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
             std::cout << "You need to start first." << std::endl;
             return 2;
         }
-        dt::duration worked = loglist->getLastEntry()->getTime() -
-                                  loglist->getLastStart()->getTime();
+        dt::duration worked = loglist->getLastEntry().getTime() -
+                                  loglist->getLastStart().getTime();
         std::cout << "End noted. You worked " << dt::toString(worked)
                   << "." << std::endl;
         return 0;
@@ -266,7 +846,8 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
             return 2;
         }
         LogList *loglist;
-        if (! getLoglist(joblog, &loglist)) return 2;
+        joblog->requestWriting();
+        if (! getLoglist(joblog, &loglist, true)) return 2;
         try {
             std::stringstream note;
             note << args[1];
@@ -282,24 +863,79 @@ int parseNormalCommand(Joblog* joblog, std::vector<string> args) {
     }
     if (args[0].compare("state") == 0) {
         LogList *loglist;
-        if (! getLoglist(joblog, &loglist)) return 2;
+        if (! getLoglist(joblog, &loglist, true)) return 2;
         if (!loglist->isActive()) {
             std::cout << "Not working." << std::endl;
             return 0;
         }
         else {
-            dt::duration worked = dt::now()-loglist->getLastStart()->getTime();
+            dt::duration worked = dt::now()-loglist->getLastStart().getTime();
             std::cout << "Worked " << dt::toString(worked) << "." << std::endl;
             return 0;
         }
     }
     if (args[0].compare("list") == 0) {
+        if (args.size() > 1 && args[1].compare("--recursive") == 0) {
+            args.erase(args.begin(), args.begin() + 2);
+            return listRecursive(args);
+        }
         LogList *loglist;
-        if (! getLoglist(joblog, &loglist)) return 2;
+        if (! getLoglist(joblog, &loglist, true)) return 2;
         args.erase(args.begin());
         return list(loglist, args);
     }
     
+    if (args[0].compare("search") == 0) {
+        args.erase(args.begin());
+        return search(joblog, args);
+    }
+    
+    if (args[0].compare("report") == 0) {
+        args.erase(args.begin());
+        return report(joblog, args);
+    }
+    
+    if (args[0].compare("batch") == 0) {
+        args.erase(args.begin());
+        return batch(joblog, args);
+    }
+    
+    if (args[0].compare("import") == 0) {
+        args.erase(args.begin());
+        return import(joblog, args);
+    }
+    
+    if (args[0].compare("convert") == 0) {
+        LogFormat format;
+        if (args.size() == 2 && args[1].compare("text") == 0) {
+            format = LogFormat::text;
+        }
+        else if (args.size() == 2 && args[1].compare("binary") == 0) {
+            format = LogFormat::binary;
+        }
+        else {
+            std::cout << "Unknown format. Use 'help convert' for help."
+                      << std::endl;
+            return 2;
+        }
+        LogList *loglist;
+        joblog->requestWriting();
+        if (! getLoglist(joblog, &loglist, false)) return 2;
+        try {
+            loglist->convert(format);
+        } catch (SituationalMistake& ex) {
+            std::cout << "The logs are already stored in this format."
+                      << std::endl;
+            return 2;
+        } catch (CorruptedFileException& ex) {
+            std::cout << "Converting failed. The exception message is:\n"
+                         "'" << ex.what() << "'" << std::endl;
+            return 2;
+        }
+        std::cout << "Converted." << std::endl;
+        return 0;
+    }
+    
     std::cout << "Unknown command '" << args[0] <<
                  "'. Use --help to see usage." << std::endl;
     return 2;
@@ -319,12 +955,19 @@ int commandLineInterface(vector<string> args) {
     // Give all the arguments to the Builder.
     // Arguments are what starts with a minus.
     Joblog *joblog = new Joblog();
+    // Checks and profiles need the files, so they are not left to a daemon.
+    bool useDaemon = true;
     while (args.size() > 0 && args[0][0]=='-') {
         if (args[0].compare(0, 6, "-path=") == 0) {
             joblog->setPath(args[0].substr(6));
         }
         else if (args[0].compare("-c") == 0) {
             joblog->doChecks();
+            useDaemon = false;
+        }
+        else if (args[0].compare("--profile") == 0) {
+            Profiler::enable();
+            useDaemon = false;
         }
         else {
             std::cout << "Unknown argument '" << args[0] << "'" << std::endl;
@@ -341,6 +984,12 @@ int commandLineInterface(vector<string> args) {
     if (args.size() == 0) {
         return 0;
     }
+    // If a daemon is running, it has the logs in memory already
+    else if (useDaemon && isDaemonCommand(args) &&
+                askDaemon(joblog->getPath(), args, res)) {
+        delete joblog;
+        return res;
+    }
     // Else, parse the command
     else {
         res = parseNormalCommand(joblog, args);
@@ -348,5 +997,7 @@ int commandLineInterface(vector<string> args) {
     
     joblog->save();
     delete joblog;
+    if (Profiler::enabled)
+        Profiler::report(std::cerr);
     return res;
 };